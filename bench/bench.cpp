@@ -0,0 +1,227 @@
+// 基准测试：分别测量词法分析、解析、两个执行引擎和启动路径（startup）在几类典型脚本上的耗时
+// 每项先预热若干次，再重复测量，报告中位数和p99；结果以制表符分隔写入bench_output.txt
+//
+// 用法：bench [--reps N] [--warmup N] [--filter 名字片段] [--output 文件]
+#include "lexer.h"
+#include "parser.h"
+#include "executor.h"
+#include "interpreter.h"
+#include "output.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define CPPYTHON_NULL_DEVICE "NUL"
+#else
+#define CPPYTHON_NULL_DEVICE "/dev/null"
+#endif
+
+namespace {
+    const char* const kTempFile = "bench_tmp.txt";
+
+    struct Workload {
+        const char* name;
+        std::string source;
+    };
+
+    struct Options {
+        int reps = 30;
+        int warmup = 3;
+        std::string filter;
+        std::string output = "bench_output.txt";
+    };
+
+    // 语言里没有循环，用生成的长脚本代替循环体
+    std::string repeat(size_t count, const std::function<std::string(size_t)>& line) {
+        std::string source;
+        for (size_t i = 0; i < count; i++) {
+            source += line(i);
+            source += '\n';
+        }
+        return source;
+    }
+
+    std::vector<Workload> makeWorkloads() {
+        std::vector<Workload> workloads;
+        // 任务调度器每次启动解释器只跑一两行，主要看startup
+        workloads.push_back({"one_liner", "x = 6\nprint(x * 7)\n"});
+        workloads.push_back({"arithmetic", "x = 1\n" + repeat(20000, [](size_t i) {
+            return "x = x * 3 % 1000 + " + std::to_string(i % 97) + " - x / 7";
+        })});
+        workloads.push_back({"compare", "x = 1\ny = 2\n" + repeat(20000, [](size_t i) {
+            return "x = x + " + std::to_string(i % 5) + "\nc = x > y\nd = x % 3 == 1";
+        })});
+        workloads.push_back({"list_build", repeat(5000, [](size_t i) {
+            std::string n = std::to_string(i);
+            return "l = [" + n + ", " + n + " + 1, [" + n + ", \"s\"], \"x\"]\ny = l[2][0] + len(l)";
+        })});
+        workloads.push_back({"fstring", "name = \"world\"\nn = 42\n" + repeat(10000, [](size_t i) {
+            return "s = f\"hello {name} #" + std::to_string(i) + ": {n * 2} {n + 0.5}\"";
+        })});
+        workloads.push_back({"print", "v = 3.25\n" + repeat(20000, [](size_t i) {
+            return "print(\"line \", " + std::to_string(i) + ", \" value \", v)";
+        })});
+        workloads.push_back({"file_io", repeat(500, [](size_t i) {
+            std::string n = std::to_string(i);
+            return std::string("with open(\"") + kTempFile + "\", \"w\") as f:\n"
+                   "    f.write(\"row " + n + "\\n\")\n\n"
+                   "with open(\"" + kTempFile + "\", \"r\") as f:\n"
+                   "    data = f.read()\n";
+        })});
+        workloads.push_back({"eval_exec", "a = 1\n" + repeat(5000, [](size_t i) {
+            return "a = eval(\"a + " + std::to_string(i % 10) + "\")\nexec(\"b = a * 2\")";
+        })});
+        return workloads;
+    }
+
+    struct Result {
+        std::string name;
+        std::string stage;
+        size_t bytes;
+        std::vector<double> samples;  // 纳秒
+
+        double percentile(double p) const {
+            std::vector<double> sorted = samples;
+            std::sort(sorted.begin(), sorted.end());
+            size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+            return sorted[std::min(index, sorted.size() - 1)];
+        }
+    };
+
+    // 计时不包括准备工作（例如执行前的解析）
+    using Stage = std::function<double(const std::string&)>;
+
+    template<typename Setup, typename Body>
+    double timed(Setup setup, Body body) {
+        auto state = setup();
+        auto start = std::chrono::steady_clock::now();
+        body(state);
+        auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(stop - start).count();
+    }
+
+    double timeLexer(const std::string& source) {
+        return timed([] { return 0; }, [&](int) {
+            Lexer lexer(source);
+            auto tokens = lexer.tokenize();
+            if (tokens.empty()) std::abort();
+        });
+    }
+
+    double timeParser(const std::string& source) {
+        return timed([] { return std::make_unique<CompilationUnit>(); },
+                     [&](std::unique_ptr<CompilationUnit>& unit) { unit->parse(source); });
+    }
+
+    double timeExecute(const std::string& source, Engine engine) {
+        struct State {
+            std::unique_ptr<CompilationUnit> unit;
+            std::unique_ptr<Executor> executor;
+        };
+        return timed([&] {
+            State state{std::make_unique<CompilationUnit>(), std::make_unique<Executor>(false)};
+            state.unit->parse(source);
+            state.executor->setEngine(engine);
+            return state;
+        }, [](State& state) {
+            state.executor->execute(*state.unit);
+            // 输出的代价也算进执行时间
+            OutputBuffer::standardOutput().flush();
+        });
+    }
+
+    // 启动路径：从构造PythonInterpreter开始，经过-c的路径（解析、编译）执行到最后一条语句
+    double timeStartup(const std::string& source) {
+        return timed([] { return 0; }, [&](int) {
+            PythonInterpreter interpreter;
+            if (!interpreter.executeCommand(source)) std::abort();
+            OutputBuffer::standardOutput().flush();
+        });
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) return false;
+            std::string value = argv[++i];
+            if (arg == "--reps") {
+                options.reps = std::max(1, std::atoi(value.c_str()));
+            } else if (arg == "--warmup") {
+                options.warmup = std::max(0, std::atoi(value.c_str()));
+            } else if (arg == "--filter") {
+                options.filter = value;
+            } else if (arg == "--output") {
+                options.output = value;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--reps N] [--warmup N] [--filter NAME] [--output FILE]" << std::endl;
+        return 1;
+    }
+
+    const std::vector<std::pair<const char*, Stage>> stages = {
+        {"lex", timeLexer},
+        {"parse", timeParser},
+        {"execute_vm", [](const std::string& s) { return timeExecute(s, Engine::VM); }},
+        {"execute_ast", [](const std::string& s) { return timeExecute(s, Engine::AST); }},
+        {"startup", timeStartup},
+    };
+
+    // 脚本自己的输出丢掉，报告写到标准错误和结果文件
+    if (!std::freopen(CPPYTHON_NULL_DEVICE, "w", stdout)) {
+        std::cerr << "Could not redirect standard output" << std::endl;
+        return 1;
+    }
+
+    std::vector<Result> results;
+    for (const auto& workload : makeWorkloads()) {
+        if (!options.filter.empty() && std::string(workload.name).find(options.filter) == std::string::npos) {
+            continue;
+        }
+        for (const auto& stage : stages) {
+            Result result{workload.name, stage.first, workload.source.size(), {}};
+            for (int i = 0; i < options.warmup; i++) {
+                stage.second(workload.source);
+            }
+            for (int i = 0; i < options.reps; i++) {
+                result.samples.push_back(stage.second(workload.source));
+            }
+            std::fprintf(stderr, "%-12s %-12s median %10.3f ms   p99 %10.3f ms\n",
+                         result.name.c_str(), result.stage.c_str(),
+                         result.percentile(0.5) / 1e6, result.percentile(0.99) / 1e6);
+            results.push_back(std::move(result));
+        }
+    }
+    std::remove(kTempFile);
+
+    std::FILE* out = std::fopen(options.output.c_str(), "w");
+    if (!out) {
+        std::cerr << "Could not open file: " << options.output << std::endl;
+        return 1;
+    }
+    std::fprintf(out, "workload\tstage\tsource_bytes\treps\tmedian_ns\tp99_ns\tmin_ns\tmb_per_s\n");
+    for (const auto& result : results) {
+        double median = result.percentile(0.5);
+        std::fprintf(out, "%s\t%s\t%zu\t%zu\t%.0f\t%.0f\t%.0f\t%.2f\n",
+                     result.name.c_str(), result.stage.c_str(), result.bytes, result.samples.size(),
+                     median, result.percentile(0.99), result.percentile(0.0),
+                     result.bytes / (median / 1e9) / (1024.0 * 1024.0));
+    }
+    std::fclose(out);
+    return 0;
+}
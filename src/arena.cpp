@@ -0,0 +1,86 @@
+#include "arena.h"
+
+Arena::Arena() : head(nullptr), cursor(nullptr), limit(nullptr), used(0) {}
+
+Arena::~Arena() {
+    release();
+}
+
+Arena::Arena(Arena&& other) noexcept
+    : head(other.head), cursor(other.cursor), limit(other.limit), used(other.used) {
+    other.head = nullptr;
+    other.cursor = nullptr;
+    other.limit = nullptr;
+    other.used = 0;
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(head, other.head);
+        std::swap(cursor, other.cursor);
+        std::swap(limit, other.limit);
+        std::swap(used, other.used);
+    }
+    return *this;
+}
+
+void* Arena::allocateSlow(size_t size, size_t align) {
+    // 超大的分配单独占一个块，避免浪费当前块的剩余空间
+    size_t payload = size + align > kBlockSize ? size + align : kBlockSize;
+    Block* block = (Block*)::operator new(sizeof(Block) + payload);
+    block->size = payload;
+
+    char* begin = (char*)(block + 1);
+    uintptr_t p = ((uintptr_t)begin + (align - 1)) & ~(uintptr_t)(align - 1);
+
+    if (payload > kBlockSize && head) {
+        // 挂在当前块之后，不影响当前块继续分配
+        block->next = head->next;
+        head->next = block;
+    } else {
+        block->next = head;
+        head = block;
+        limit = begin + payload;
+        cursor = (char*)(p + size);
+    }
+    used += size;
+    return (void*)p;
+}
+
+void Arena::release() {
+    Block* block = head;
+    while (block) {
+        Block* next = block->next;
+        ::operator delete(block);
+        block = next;
+    }
+    head = nullptr;
+    cursor = nullptr;
+    limit = nullptr;
+    used = 0;
+}
+
+void Arena::reset() {
+    Block* keep = nullptr;
+    Block* block = head;
+    while (block) {
+        Block* next = block->next;
+        if (!keep && block->size == kBlockSize) {
+            keep = block;
+        } else {
+            ::operator delete(block);
+        }
+        block = next;
+    }
+    head = keep;
+    if (keep) {
+        keep->next = nullptr;
+        cursor = (char*)(keep + 1);
+        limit = cursor + keep->size;
+    } else {
+        cursor = nullptr;
+        limit = nullptr;
+    }
+    used = 0;
+}
@@ -0,0 +1,108 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 竞技场中的节点数组：指针加长度，内存归Arena所有
+template<typename T>
+class NodeList {
+private:
+    T** items;
+    size_t count;
+
+public:
+    NodeList() : items(nullptr), count(0) {}
+    NodeList(T** data, size_t n) : items(data), count(n) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T*& operator[](size_t i) const { return items[i]; }
+    T** begin() const { return items; }
+    T** end() const { return items + count; }
+};
+
+// 竞技场（bump）分配器：一个编译单元的全部AST节点和token文本都从这里分配，
+// 销毁时整块释放，不逐个调用析构函数，所以放进来的对象必须可平凡析构
+class Arena {
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    Block* head;
+    char* cursor;
+    char* limit;
+    size_t used;
+
+    void* allocateSlow(size_t size, size_t align);
+
+public:
+    Arena();
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+
+    void* allocate(size_t size, size_t align) {
+        uintptr_t p = ((uintptr_t)cursor + (align - 1)) & ~(uintptr_t)(align - 1);
+        if (cursor && p + size <= (uintptr_t)limit) {
+            cursor = (char*)(p + size);
+            used += size;
+            return (void*)p;
+        }
+        return allocateSlow(size, align);
+    }
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "arena objects are released in bulk and never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // 把文本复制到竞技场中，返回指向副本的视图
+    std::string_view copyString(std::string_view text) {
+        if (text.empty()) return std::string_view();
+        char* data = (char*)allocate(text.size(), 1);
+        std::memcpy(data, text.data(), text.size());
+        return std::string_view(data, text.size());
+    }
+
+    template<typename T>
+    NodeList<T> makeList(const std::vector<T*>& nodes) {
+        if (nodes.empty()) return NodeList<T>();
+        T** data = (T**)allocate(sizeof(T*) * nodes.size(), alignof(T*));
+        std::memcpy(data, nodes.data(), sizeof(T*) * nodes.size());
+        return NodeList<T>(data, nodes.size());
+    }
+
+    // 把可平凡复制的元素数组复制到竞技场中
+    template<typename T>
+    T* copyArray(const std::vector<T>& items) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "arena arrays are copied with memcpy");
+        if (items.empty()) return nullptr;
+        T* data = (T*)allocate(sizeof(T) * items.size(), alignof(T));
+        std::memcpy(data, items.data(), sizeof(T) * items.size());
+        return data;
+    }
+
+    // 一次性释放所有内存块
+    void release();
+    // 丢弃全部内容但保留一个标准大小的块，供反复解析的场合（交互模式）复用
+    void reset();
+    size_t bytesUsed() const { return used; }
+};
+
+#endif
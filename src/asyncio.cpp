@@ -0,0 +1,479 @@
+#include "asyncio.h"
+#include "stats.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <cstdio>
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define CPPYTHON_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace {
+    // 票据的高位是发出它的io_uring的编号（0表示线程池），低位是这个后端里的序号
+    constexpr int kOwnerShift = 40;
+
+    uint32_t ownerOf(AsyncIO::Ticket ticket) {
+        return static_cast<uint32_t>(ticket >> kOwnerShift);
+    }
+
+    // 同步的按位置读写（线程池在后台线程上调用）
+    long long transferAt(int fd, char* buffer, size_t length, uint64_t offset, bool writing) {
+#ifdef _WIN32
+        // 同一个文件同一时间只有一个请求，先定位再读写不会互相干扰
+        if (_lseeki64(fd, (long long)offset, SEEK_SET) < 0) return -1;
+        unsigned count = length > 0x7fffffffu ? 0x7fffffffu : (unsigned)length;
+        return writing ? _write(fd, buffer, count) : _read(fd, buffer, count);
+#else
+        while (true) {
+            ssize_t n = writing ? pwrite(fd, buffer, length, (off_t)offset)
+                                : pread(fd, buffer, length, (off_t)offset);
+            if (n >= 0 || errno != EINTR) return n;
+        }
+#endif
+    }
+
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+        virtual AsyncIO::Ticket queue(int fd, char* buffer, size_t length, uint64_t offset, bool writing) = 0;
+        virtual void submit() = 0;
+        virtual const char* name() const = 0;
+    };
+
+    // 线程池后端：进程内共享几个后台线程。请求排队时就放进共享的工作队列，
+    // submit()时才一起唤醒后台线程；任何线程的submit()或wait()都会交出所有排队的请求，
+    // 发出请求的线程退出了也不会丢
+    class ThreadBackend : public Backend {
+    public:
+        static constexpr size_t kThreads = 4;
+
+        ~ThreadBackend() override {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& thread : threads) thread.join();
+        }
+
+        AsyncIO::Ticket queue(int fd, char* buffer, size_t length, uint64_t offset, bool writing) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            AsyncIO::Ticket ticket = ++lastTicket;
+            requests[ticket] = Request{fd, buffer, length, offset, writing, false, 0};
+            work.push_back(ticket);
+            unannounced++;
+            return ticket;
+        }
+
+        void submit() override {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (unannounced == 0) return;
+                unannounced = 0;
+                if (threads.empty()) {
+                    for (size_t i = 0; i < kThreads; i++) {
+                        threads.emplace_back(&ThreadBackend::workerLoop, this);
+                    }
+                }
+            }
+            CPPYTHON_STAT(async_submits, 1);
+            wake.notify_all();
+        }
+
+        // 任何线程都可以等待，请求由共用的后台线程完成
+        long long wait(AsyncIO::Ticket ticket) {
+            submit();
+            std::unique_lock<std::mutex> lock(mutex);
+            auto it = requests.find(ticket);
+            if (it == requests.end()) throw std::logic_error("AsyncIO::wait: unknown ticket");
+            done.wait(lock, [&] { return it->second.finished; });
+            long long result = it->second.result;
+            requests.erase(it);
+            return result;
+        }
+
+        const char* name() const override { return "threads"; }
+
+    private:
+        struct Request {
+            int fd;
+            char* buffer;
+            size_t length;
+            uint64_t offset;
+            bool writing;
+            bool finished;
+            long long result;
+        };
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::vector<std::thread> threads;
+        std::unordered_map<AsyncIO::Ticket, Request> requests;  // 由mutex保护，节点地址不变
+        std::deque<AsyncIO::Ticket> work;
+        size_t unannounced = 0;  // 排队以后还没有唤醒过后台线程的请求数
+        AsyncIO::Ticket lastTicket = 0;
+        bool stopping = false;
+
+        void workerLoop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [this] { return stopping || !work.empty(); });
+                if (work.empty()) return;
+                Request& request = requests[work.front()];
+                work.pop_front();
+                lock.unlock();
+                long long result = transferAt(request.fd, request.buffer, request.length,
+                                              request.offset, request.writing);
+                lock.lock();
+                request.result = result;
+                request.finished = true;
+                done.notify_all();
+            }
+        }
+    };
+
+#ifdef CPPYTHON_HAVE_IO_URING
+    class UringBackend;
+
+    // 所有线程的io_uring：另一个线程等待请求时经由这里找到发出它的实例
+    struct RingRegistry {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, UringBackend*> rings;
+        std::unordered_map<AsyncIO::Ticket, long long> orphans;  // 所属线程已经退出、还没人取的结果
+    };
+
+    RingRegistry& registry() {
+        static RingRegistry shared;
+        return shared;
+    }
+
+    // io_uring后端：提交队列和完成队列都映射到用户空间，
+    // 排队只是填写提交队列的条目，submit()时一次io_uring_enter交给内核
+    //
+    // 每个线程有自己的实例，由这个线程排队和提交；文件对象可能在另一个线程上关闭，
+    // 所以等待可以来自任何线程，实例的状态都由mutex保护（平时没有争用）
+    class UringBackend : public Backend {
+    public:
+        static constexpr unsigned kEntries = 64;
+
+        UringBackend() {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            ringFd = (int)syscall(__NR_io_uring_setup, kEntries, &params);
+            if (ringFd < 0) return;
+
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+            }
+            sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+            cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqeMemory = map(sqesSize, IORING_OFF_SQES);
+            if (!sqRing || !cqRing || !sqeMemory) {
+                if (sqeMemory) munmap(sqeMemory, sqesSize);
+                release();
+                return;
+            }
+
+            char* sq = static_cast<char*>(sqRing);
+            sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            sqes = static_cast<io_uring_sqe*>(sqeMemory);
+            char* cq = static_cast<char*>(cqRing);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            entries = params.sq_entries;
+
+            static std::atomic<uint32_t> nextId(1);
+            id = nextId.fetch_add(1, std::memory_order_relaxed);
+            RingRegistry& shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.rings[id] = this;
+        }
+
+        ~UringBackend() override {
+            if (ringFd >= 0) {
+                // 先摘掉登记，之后别的线程找不到这个实例；正在等待的线程持有mutex，等它结束
+                RingRegistry& shared = registry();
+                std::lock_guard<std::mutex> registryLock(shared.mutex);
+                std::lock_guard<std::mutex> lock(mutex);
+                shared.rings.erase(id);
+                // 内核还可能往缓冲区里写，先等所有请求完成；没人等过的结果留给其他线程
+                try {
+                    submitLocked();
+                    while (inflight > 0) enter(0, 1);
+                } catch (const std::exception&) {
+                }
+                for (const auto& entry : requests) {
+                    if (entry.second.finished) shared.orphans[entry.first] = entry.second.result;
+                }
+            }
+            release();
+        }
+
+        bool ready() const { return ringFd >= 0; }
+
+        AsyncIO::Ticket queue(int fd, char* buffer, size_t length, uint64_t offset, bool writing) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            // 完成队列不能溢出：在途请求占满时先收一个结果
+            while (inflight + queued >= entries) {
+                if (queued > 0) submitLocked();
+                else enter(0, 1);
+            }
+            AsyncIO::Ticket ticket = (static_cast<AsyncIO::Ticket>(id) << kOwnerShift) | ++lastTicket;
+            Request& request = requests[ticket];
+            request.vector.iov_base = buffer;
+            request.vector.iov_len = length;
+
+            unsigned tail = *sqTail;
+            unsigned index = tail & sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = writing ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe.fd = fd;
+            sqe.off = offset;
+            sqe.addr = reinterpret_cast<uint64_t>(&request.vector);
+            sqe.len = 1;
+            sqe.user_data = ticket;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            queued++;
+            return ticket;
+        }
+
+        void submit() override {
+            std::lock_guard<std::mutex> lock(mutex);
+            submitLocked();
+        }
+
+        // 等待票据所属的实例上的请求；实例所在的线程已经退出时从orphans里取结果
+        static long long wait(AsyncIO::Ticket ticket);
+
+        const char* name() const override { return "io_uring"; }
+
+    private:
+        struct Request {
+            iovec vector;  // READV/WRITEV引用它，完成之前地址不能变
+            bool finished = false;
+            long long result = 0;
+        };
+
+        int ringFd = -1;
+        void* sqRing = nullptr;
+        void* cqRing = nullptr;
+        size_t sqRingSize = 0;
+        size_t cqRingSize = 0;
+        size_t sqesSize = 0;
+        unsigned* sqHead = nullptr;
+        unsigned* sqTail = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned sqMask = 0;
+        io_uring_sqe* sqes = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned cqMask = 0;
+        io_uring_cqe* cqes = nullptr;
+        unsigned entries = 0;
+        unsigned queued = 0;    // 已填写、还没交给内核的条目
+        unsigned inflight = 0;  // 已交给内核、还没收到结果的请求
+        std::unordered_map<AsyncIO::Ticket, Request> requests;
+        AsyncIO::Ticket lastTicket = 0;
+        uint32_t id = 0;  // 进程内唯一，写在票据的高位
+        std::mutex mutex;
+
+        void submitLocked() {
+            if (queued == 0) return;
+            CPPYTHON_STAT(async_submits, 1);
+            enter(queued, 0);
+        }
+
+        long long waitLocked(AsyncIO::Ticket ticket) {
+            auto it = requests.find(ticket);
+            if (it == requests.end()) throw std::logic_error("AsyncIO::wait: unknown ticket");
+            submitLocked();
+            while (!it->second.finished) enter(0, 1);
+            long long result = it->second.result;
+            requests.erase(it);
+            return result;
+        }
+
+        void* map(size_t size, uint64_t offset) {
+            void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                ringFd, (off_t)offset);
+            return memory == MAP_FAILED ? nullptr : memory;
+        }
+
+        void release() {
+            if (sqes) munmap(sqes, sqesSize);
+            if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+            if (sqRing) munmap(sqRing, sqRingSize);
+            sqes = nullptr;
+            sqRing = cqRing = nullptr;
+            if (ringFd >= 0) close(ringFd);
+            ringFd = -1;
+        }
+
+        // 提交toSubmit个条目，并等待至少minComplete个结果
+        void enter(unsigned toSubmit, unsigned minComplete) {
+            while (true) {
+                long n = syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete,
+                                 minComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (n >= 0) {
+                    queued -= (unsigned)n;
+                    inflight += (unsigned)n;
+                    toSubmit -= (unsigned)n;
+                    if (toSubmit == 0) break;
+                    continue;
+                }
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EBUSY) {
+                    // 内核暂时收不下：先收已完成的结果再试
+                    if (reap() == 0 && inflight > 0) {
+                        syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    }
+                    continue;
+                }
+                throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+            }
+            reap();
+        }
+
+        size_t reap() {
+            size_t count = 0;
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++, count++) {
+                const io_uring_cqe& cqe = cqes[head & cqMask];
+                auto it = requests.find(cqe.user_data);
+                if (it != requests.end()) {
+                    it->second.finished = true;
+                    it->second.result = cqe.res < 0 ? -1 : cqe.res;
+                }
+                inflight--;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            return count;
+        }
+    };
+
+    thread_local std::unique_ptr<UringBackend> localRing;  // 本线程的io_uring
+
+    long long UringBackend::wait(AsyncIO::Ticket ticket) {
+        // 自己线程上的请求不经过登记表：线程还在运行，实例不会被销毁
+        UringBackend* local = localRing.get();
+        if (local && local->id == ownerOf(ticket)) {
+            std::lock_guard<std::mutex> lock(local->mutex);
+            return local->waitLocked(ticket);
+        }
+        RingRegistry& shared = registry();
+        std::unique_lock<std::mutex> registryLock(shared.mutex);
+        auto ring = shared.rings.find(ownerOf(ticket));
+        if (ring == shared.rings.end()) {
+            auto orphan = shared.orphans.find(ticket);
+            if (orphan == shared.orphans.end()) throw std::logic_error("AsyncIO::wait: unknown ticket");
+            long long result = orphan->second;
+            shared.orphans.erase(orphan);
+            return result;
+        }
+        // 拿到实例的锁以后才放开登记表，实例在这期间不会被销毁
+        UringBackend& owner = *ring->second;
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        registryLock.unlock();
+        return owner.waitLocked(ticket);
+    }
+#endif
+
+    ThreadBackend& threadBackend() {
+        static ThreadBackend backend;
+        return backend;
+    }
+
+    bool forceThreads() {
+        static const bool forced = [] {
+            const char* setting = std::getenv("CPPYTHON_ASYNC_IO");
+            return setting && std::string(setting) == "threads";
+        }();
+        return forced;
+    }
+
+    // 本线程的后端：第一次使用时尝试建立io_uring，失败后一直用线程池
+    Backend& current() {
+        static thread_local Backend* backend = nullptr;
+        if (backend) return *backend;
+#ifdef CPPYTHON_HAVE_IO_URING
+        static std::atomic<bool> uringFailed(false);
+        if (!forceThreads() && !uringFailed.load(std::memory_order_relaxed)) {
+            localRing = std::make_unique<UringBackend>();
+            if (localRing->ready()) {
+                backend = localRing.get();
+                return *backend;
+            }
+            localRing.reset();
+            uringFailed.store(true, std::memory_order_relaxed);
+        }
+#endif
+        backend = &threadBackend();
+        return *backend;
+    }
+}
+
+AsyncIO::Ticket AsyncIO::read(int fd, char* buffer, size_t length, uint64_t offset) {
+    CPPYTHON_STAT(async_reads, 1);
+    return current().queue(fd, buffer, length, offset, false);
+}
+
+AsyncIO::Ticket AsyncIO::write(int fd, const char* data, size_t length, uint64_t offset) {
+    CPPYTHON_STAT(async_writes, 1);
+    // 写请求只读缓冲区，READV/WRITEV共用同一个iovec结构
+    return current().queue(fd, const_cast<char*>(data), length, offset, true);
+}
+
+void AsyncIO::submit() {
+    current().submit();
+}
+
+long long AsyncIO::wait(Ticket ticket) {
+    if (ticket == 0) return -1;
+    // 交给发出请求的后端，不一定是当前线程的后端
+#ifdef CPPYTHON_HAVE_IO_URING
+    if (ownerOf(ticket) != 0) return UringBackend::wait(ticket);
+#endif
+    return threadBackend().wait(ticket);
+}
+
+const char* AsyncIO::backend() {
+    return current().name();
+}
@@ -0,0 +1,31 @@
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 文件对象的异步读写后端：Linux上用io_uring（直接发系统调用，不依赖liburing），
+// 内核不支持、被禁用或不是Linux时退化为后台线程池
+//
+// 请求按文件偏移读写，缓冲区在wait()返回之前必须保持有效。read()/write()只是排队，
+// 排队的请求在submit()、wait()或者队列满时一次性交给内核，连续打开很多文件时
+// 它们的预读只需要一次系统调用
+//
+// 每个线程有自己的io_uring。请求可以在任何线程上等待（文件对象可能在另一个线程上关闭），
+// 等待会交给发出请求的那个io_uring；每个请求只能等待一次。
+// 设置环境变量CPPYTHON_ASYNC_IO=threads可以强制使用线程池
+namespace AsyncIO {
+    using Ticket = uint64_t;  // 0表示没有请求
+
+    Ticket read(int fd, char* buffer, size_t length, uint64_t offset);
+    Ticket write(int fd, const char* data, size_t length, uint64_t offset);
+    // 把排队的请求交出去，不等待
+    void submit();
+    // 等待请求完成：返回传输的字节数，出错时返回-1；
+    // ticket不是一个还没等待过的请求时抛出std::logic_error
+    long long wait(Ticket ticket);
+    // 当前线程使用的后端："io_uring"或"threads"
+    const char* backend();
+}
+
+#endif
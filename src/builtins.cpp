@@ -0,0 +1,51 @@
+#include "builtins.h"
+#include "perfect_hash.h"
+
+namespace {
+    constexpr KeyValue<Builtin> kBuiltinList[] = {
+        {"str", Builtin::STR},
+        {"repr", Builtin::REPR},
+        {"int", Builtin::INT},
+        {"float", Builtin::FLOAT},
+        {"bool", Builtin::BOOL},
+        {"len", Builtin::LEN},
+        {"input", Builtin::INPUT},
+        {"print", Builtin::PRINT},
+        {"open", Builtin::OPEN},
+        {"eval", Builtin::EVAL},
+        {"exec", Builtin::EXEC},
+        {"stats", Builtin::STATS},
+        {"sum", Builtin::SUM},
+        {"min", Builtin::MIN},
+        {"max", Builtin::MAX},
+    };
+
+    constexpr PerfectHash<Builtin, 32> kBuiltins(kBuiltinList);
+}
+
+Builtin Builtins::lookup(std::string_view name) {
+    return kBuiltins.find(name, Builtin::NONE);
+}
+
+const char* Builtins::name(Builtin id) {
+    switch (id) {
+        case Builtin::STR: return "str";
+        case Builtin::REPR: return "repr";
+        case Builtin::INT: return "int";
+        case Builtin::FLOAT: return "float";
+        case Builtin::BOOL: return "bool";
+        case Builtin::LEN: return "len";
+        case Builtin::INPUT: return "input";
+        case Builtin::PRINT: return "print";
+        case Builtin::OPEN: return "open";
+        case Builtin::EVAL: return "eval";
+        case Builtin::EXEC: return "exec";
+        case Builtin::STATS: return "stats";
+        case Builtin::SUM: return "sum";
+        case Builtin::MIN: return "min";
+        case Builtin::MAX: return "max";
+        case Builtin::NONE:
+        default:
+            return "";
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <string_view>
+
+// 内置函数编号（AST执行器和字节码虚拟机共用）
+enum class Builtin {
+    NONE,  // 不是内置函数
+    STR, REPR, INT, FLOAT, BOOL, LEN,
+    INPUT, PRINT, OPEN, EVAL, EXEC, STATS,
+    SUM, MIN, MAX
+};
+
+namespace Builtins {
+    Builtin lookup(std::string_view name);
+    const char* name(Builtin id);
+}
+
+#endif
@@ -0,0 +1,333 @@
+#include "bytecache.h"
+#include "builtins.h"
+#include "compiler.h"
+#include "interpreter.h"
+#include "resolver.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // 文件布局、常量编码或Builtin/TokenType编号变化时加一；指令表的变化由kOpcodeHash检测
+    constexpr uint32_t kFormatVersion = 5;
+
+    constexpr uint32_t hashOpcodeNames(const char* text) {
+        uint32_t h = 2166136261u;
+        for (; *text; text++) {
+            h = (h ^ static_cast<unsigned char>(*text)) * 16777619u;
+        }
+        return h;
+    }
+
+#define CPPYTHON_OPCODE_NAME(name) #name ","
+    constexpr uint32_t kOpcodeHash = hashOpcodeNames(CPPYTHON_OPCODES(CPPYTHON_OPCODE_NAME));
+#undef CPPYTHON_OPCODE_NAME
+    constexpr char kMagic[8] = {'C', 'P', 'Y', 'C', 'O', 'D', 'E', '\0'};
+
+    // FNV-1a，检测缓存文件头之后的内容是否损坏
+    uint32_t checksum(std::string_view data) {
+        uint32_t h = 2166136261u;
+        for (char c : data) {
+            h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return h;
+    }
+
+    // 缓存文件头，后面依次是源文件路径、指令数组、行号表、常量池和变量名表
+    struct Header {
+        char magic[8];
+        char version[16];        // 解释器版本
+        uint32_t format;
+        uint32_t opcodeHash;     // 指令表指纹
+        uint32_t instructionSize;
+        int64_t mtime;           // 源文件修改时间
+        uint64_t sourceSize;     // 源文件大小
+        uint64_t maxStackDepth;
+        uint32_t pathLength;
+        uint32_t instructionCount;
+        uint32_t constantCount;
+        uint32_t nameCount;
+        uint32_t checksum;       // 文件头之后全部内容的校验和
+    };
+
+    enum class ConstTag : uint8_t { NONE, NUMBER, BOOLEAN, STRING };
+
+    // 源文件的身份：规范化的绝对路径、修改时间和大小
+    struct SourceKey {
+        std::string path;
+        int64_t mtime = 0;
+        uint64_t size = 0;
+    };
+
+    bool sourceKey(const std::string& source, SourceKey& key) {
+        std::error_code ec;
+        fs::path absolute = fs::absolute(source, ec);
+        if (ec) return false;
+        key.path = absolute.lexically_normal().string();
+        auto time = fs::last_write_time(absolute, ec);
+        if (ec) return false;
+        key.mtime = static_cast<int64_t>(time.time_since_epoch().count());
+        key.size = static_cast<uint64_t>(fs::file_size(absolute, ec));
+        return !ec;
+    }
+
+    void fillHeader(Header& header) {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        std::strncpy(header.version, CPPYTHON_VERSION, sizeof(header.version) - 1);
+        header.format = kFormatVersion;
+        header.opcodeHash = kOpcodeHash;
+        header.instructionSize = sizeof(Instruction);
+    }
+
+    // 带边界检查的顺序读取，越界后所有读取都失败
+    class Reader {
+    private:
+        const char* pos;
+        const char* end;
+
+    public:
+        explicit Reader(std::string_view data) : pos(data.data()), end(data.data() + data.size()) {}
+
+        bool read(void* out, size_t n) {
+            if (static_cast<size_t>(end - pos) < n) return false;
+            std::memcpy(out, pos, n);
+            pos += n;
+            return true;
+        }
+
+        bool readView(size_t n, std::string_view& out) {
+            if (static_cast<size_t>(end - pos) < n) return false;
+            out = std::string_view(pos, n);
+            pos += n;
+            return true;
+        }
+
+        bool readString(std::string_view& out) {
+            uint32_t length;
+            return read(&length, sizeof(length)) && readView(length, out);
+        }
+    };
+
+    void appendRaw(std::string& out, const void* data, size_t n) {
+        out.append(static_cast<const char*>(data), n);
+    }
+
+    void appendString(std::string& out, std::string_view text) {
+        uint32_t length = static_cast<uint32_t>(text.size());
+        appendRaw(out, &length, sizeof(length));
+        out.append(text);
+    }
+
+    constexpr uint8_t kOpcodeCount = 0
+#define CPPYTHON_OPCODE_COUNT(name) + 1
+        CPPYTHON_OPCODES(CPPYTHON_OPCODE_COUNT)
+#undef CPPYTHON_OPCODE_COUNT
+        ;
+
+    // 虚拟机不做任何检查，缓存里的指令在执行前逐条校验：操作数不越界，
+    // 栈不会下溢，with语句成对出现，代码以HALT或RETURN_VALUE结束；
+    // 栈深度按指令重新推算，和文件头记录的值不一致时拒绝
+    bool verify(const CodeObject& code, size_t nameCount, uint64_t maxStackDepth) {
+        if (code.code.empty()) return false;
+        OpCode last = code.code.back().op;
+        if (last != OpCode::HALT && last != OpCode::RETURN_VALUE) return false;
+
+        size_t depth = 0;
+        size_t maxDepth = 0;
+        std::vector<size_t> withDepths;  // 每个未退出的with语句的上下文对象所在的栈深度
+        for (const auto& inst : code.code) {
+            if (static_cast<uint8_t>(inst.op) >= kOpcodeCount) return false;
+            switch (inst.op) {
+                case OpCode::LOAD_CONST:
+                    if (inst.a >= code.constants.size()) return false;
+                    break;
+                case OpCode::BINARY_CONST:
+                    if (inst.a >= code.constants.size() ||
+                        code.constants[inst.a].type != Value::Type::NUMBER) return false;
+                    break;
+                case OpCode::CALL_METHOD:
+                    if (inst.a >= code.constants.size() ||
+                        code.constants[inst.a].type != Value::Type::STRING) return false;
+                    break;
+                case OpCode::CALL_BUILTIN:
+                    // Builtin::MAX是最后一个内置函数
+                    if (inst.a == static_cast<uint32_t>(Builtin::NONE) ||
+                        inst.a > static_cast<uint32_t>(Builtin::MAX)) return false;
+                    break;
+                default:
+                    break;
+            }
+            if (inst.usesSlot() && inst.a >= nameCount) return false;
+
+            if (depth < inst.stackInputs()) return false;
+            if (inst.op == OpCode::EXIT_WITH) {
+                if (withDepths.empty() || withDepths.back() != depth) return false;
+                withDepths.pop_back();
+            }
+            depth = depth - inst.stackInputs() + inst.stackOutputs();
+            maxDepth = std::max(maxDepth, depth);
+            if (inst.op == OpCode::ENTER_WITH) {
+                withDepths.push_back(depth);
+            }
+        }
+        return withDepths.empty() && maxDepth == maxStackDepth;
+    }
+}
+
+std::string BytecodeCache::pathFor(const std::string& source) {
+    fs::path path(source);
+    fs::path name = path.stem();
+    name += ".cppython-" CPPYTHON_VERSION ".cppyc";
+    return (path.parent_path() / "__pycache__" / name).string();
+}
+
+std::unique_ptr<CodeObject> BytecodeCache::load(const std::string& source, SymbolTable& symbols) {
+    SourceKey key;
+    if (!sourceKey(source, key)) return nullptr;
+
+    Utils::MappedFile file;
+    if (!file.open(pathFor(source))) return nullptr;
+    Reader reader(file.view());
+
+    Header header;
+    Header expected;
+    fillHeader(expected);
+    if (!reader.read(&header, sizeof(header)) ||
+        std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        std::memcmp(header.version, expected.version, sizeof(header.version)) != 0 ||
+        header.format != expected.format || header.opcodeHash != expected.opcodeHash ||
+        header.instructionSize != expected.instructionSize ||
+        header.mtime != key.mtime || header.sourceSize != key.size ||
+        header.checksum != checksum(file.view().substr(sizeof(header)))) {
+        return nullptr;
+    }
+    std::string_view path;
+    if (!reader.readView(header.pathLength, path) || path != key.path) return nullptr;
+
+    auto code = std::make_unique<CodeObject>();
+    code->code.assign(header.instructionCount, Instruction(OpCode::HALT));
+    if (!reader.read(code->code.data(), header.instructionCount * sizeof(Instruction))) return nullptr;
+    code->lines.resize(header.instructionCount);
+    if (!reader.read(code->lines.data(), header.instructionCount * sizeof(uint32_t))) return nullptr;
+
+    code->constants.reserve(header.constantCount);
+    for (uint32_t i = 0; i < header.constantCount; i++) {
+        ConstTag tag;
+        if (!reader.read(&tag, sizeof(tag))) return nullptr;
+        switch (tag) {
+            case ConstTag::NONE:
+                code->constants.emplace_back();
+                break;
+            case ConstTag::NUMBER: {
+                double number;
+                if (!reader.read(&number, sizeof(number))) return nullptr;
+                code->constants.emplace_back(number);
+                break;
+            }
+            case ConstTag::BOOLEAN: {
+                uint8_t flag;
+                if (!reader.read(&flag, sizeof(flag))) return nullptr;
+                code->constants.emplace_back(flag != 0);
+                break;
+            }
+            case ConstTag::STRING: {
+                std::string_view text;
+                if (!reader.readString(text)) return nullptr;
+                code->constants.emplace_back(text);
+                break;
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    // 缓存里的槽位编号按名字映射到当前符号表
+    std::vector<std::string_view> names(header.nameCount);
+    for (auto& name : names) {
+        if (!reader.readString(name)) return nullptr;
+    }
+    if (!verify(*code, names.size(), header.maxStackDepth)) return nullptr;
+    code->maxStackDepth = header.maxStackDepth;
+    std::vector<uint32_t> slots(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        slots[i] = symbols.intern(names[i]);
+    }
+    code->remapSlots(slots);
+    return code;
+}
+
+bool BytecodeCache::store(const std::string& source, const CodeObject& code, const SymbolTable& symbols) {
+    SourceKey key;
+    if (!sourceKey(source, key)) return false;
+
+    std::string data;
+    Header header;
+    fillHeader(header);
+    header.mtime = key.mtime;
+    header.sourceSize = key.size;
+    header.maxStackDepth = code.maxStackDepth;
+    header.pathLength = static_cast<uint32_t>(key.path.size());
+    header.instructionCount = static_cast<uint32_t>(code.code.size());
+    header.constantCount = static_cast<uint32_t>(code.constants.size());
+    header.nameCount = static_cast<uint32_t>(symbols.size());
+    appendRaw(data, &header, sizeof(header));
+    data += key.path;
+    appendRaw(data, code.code.data(), code.code.size() * sizeof(Instruction));
+    appendRaw(data, code.lines.data(), code.lines.size() * sizeof(uint32_t));
+
+    for (const auto& constant : code.constants) {
+        switch (constant.type) {
+            case Value::Type::NONE:
+                data += static_cast<char>(ConstTag::NONE);
+                break;
+            case Value::Type::NUMBER:
+                data += static_cast<char>(ConstTag::NUMBER);
+                appendRaw(data, &constant.number, sizeof(constant.number));
+                break;
+            case Value::Type::BOOLEAN:
+                data += static_cast<char>(ConstTag::BOOLEAN);
+                data += static_cast<char>(constant.boolean ? 1 : 0);
+                break;
+            case Value::Type::STRING:
+                data += static_cast<char>(ConstTag::STRING);
+                appendString(data, constant.stringValue());
+                break;
+            default:
+                return false;  // 其他类型不会出现在常量池里
+        }
+    }
+    for (size_t i = 0; i < symbols.size(); i++) {
+        appendString(data, symbols.name(static_cast<uint32_t>(i)));
+    }
+    uint32_t sum = checksum(std::string_view(data).substr(sizeof(header)));
+    std::memcpy(data.data() + offsetof(Header, checksum), &sum, sizeof(sum));
+
+    std::error_code ec;
+    fs::path target(pathFor(source));
+    fs::create_directories(target.parent_path(), ec);
+    if (ec) return false;
+
+    // 先写到临时文件再改名，并发运行的进程不会读到写了一半的缓存
+    fs::path temp = target;
+    temp += "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    std::FILE* out = std::fopen(temp.string().c_str(), "wb");
+    if (!out) return false;
+    bool ok = std::fwrite(data.data(), 1, data.size(), out) == data.size();
+    ok = std::fclose(out) == 0 && ok;
+    if (ok) {
+        fs::rename(temp, target, ec);
+        ok = !ec;
+    }
+    if (!ok) {
+        fs::remove(temp, ec);
+    }
+    return ok;
+}
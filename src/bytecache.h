@@ -0,0 +1,22 @@
+#ifndef BYTECACHE_H
+#define BYTECACHE_H
+
+#include <memory>
+#include <string>
+
+struct CodeObject;
+class SymbolTable;
+
+// 脚本的磁盘字节码缓存（类似.pyc）
+// 编译结果写到源文件旁边的__pycache__目录，按源文件路径、修改时间、大小和解释器版本校验；
+// 缓存文件整体映射进内存，指令数组直接拷贝，不再经过词法分析、解析和编译
+namespace BytecodeCache {
+    // source对应的缓存文件路径
+    std::string pathFor(const std::string& source);
+    // 读取并校验缓存，变量名按顺序登记到symbols并改写槽位；缓存缺失或失效时返回nullptr
+    std::unique_ptr<CodeObject> load(const std::string& source, SymbolTable& symbols);
+    // 写入缓存（先写临时文件再改名），目录不可写等失败情况直接忽略
+    bool store(const std::string& source, const CodeObject& code, const SymbolTable& symbols);
+}
+
+#endif
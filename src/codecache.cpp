@@ -0,0 +1,50 @@
+#include "codecache.h"
+#include "compiler.h"
+
+CodeCache::Entry::Entry(std::string text) : source(std::move(text)) {}
+
+CodeCache::Entry::~Entry() = default;
+
+CodeCache::CodeCache(size_t capacity) : limit(capacity ? capacity : 1) {}
+
+CodeCache::~CodeCache() = default;
+
+CodeCache::Entry* CodeCache::find(std::string_view source) {
+    auto it = index.find(source);
+    if (it == index.end()) {
+        missCount++;
+        return nullptr;
+    }
+    hitCount++;
+    // 移到最前面；splice不移动节点，键和AST里的视图仍然有效
+    entries.splice(entries.begin(), entries, it->second);
+    return &*it->second;
+}
+
+CodeCache::Entry& CodeCache::insert(std::string source) {
+    // 从最久未用的一端淘汰，跳过正在执行的条目
+    if (entries.size() >= limit) {
+        for (auto it = entries.end(); it != entries.begin();) {
+            --it;
+            if (it->pins == 0) {
+                index.erase(std::string_view(it->source));
+                entries.erase(it);
+                evictionCount++;
+                break;
+            }
+        }
+    }
+
+    entries.emplace_front(std::move(source));
+    Entry& entry = entries.front();
+    index.emplace(std::string_view(entry.source), entries.begin());
+    return entry;
+}
+
+void CodeCache::erase(Entry& entry) {
+    auto it = index.find(entry.source);
+    if (it == index.end()) return;
+    auto node = it->second;
+    index.erase(it);
+    entries.erase(node);
+}
@@ -0,0 +1,72 @@
+#ifndef CODECACHE_H
+#define CODECACHE_H
+
+#include "parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct CodeObject;
+
+// eval()/exec()的编译缓存：按源码文本索引，容量有限，按最近最少使用淘汰
+// 命中时跳过词法分析、解析和常量折叠；槽位解析和字节码在符号表变化后才重做
+class CodeCache {
+public:
+    struct Entry {
+        std::string source;                // 缓存键，同时是AST引用的源码
+        CompilationUnit unit;              // AST和它的Arena
+        ExprNode* expr = nullptr;          // eval：解析出的表达式，解析失败为nullptr
+        std::unique_ptr<CodeObject> code;  // 虚拟机字节码，按需编译
+        size_t symbolCount = SIZE_MAX;     // 上次解析槽位时符号表的大小，SIZE_MAX表示还没解析过
+        int pins = 0;                      // 正在执行的次数，执行中的条目不会被淘汰
+
+        explicit Entry(std::string text);
+        ~Entry();
+    };
+
+    // 执行期间固定条目，防止嵌套的eval/exec把它淘汰
+    class Pin {
+    private:
+        Entry& entry;
+
+    public:
+        explicit Pin(Entry& e) : entry(e) { entry.pins++; }
+        ~Pin() { entry.pins--; }
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+    };
+
+    explicit CodeCache(size_t capacity = kDefaultCapacity);
+    ~CodeCache();
+    CodeCache(const CodeCache&) = delete;
+    CodeCache& operator=(const CodeCache&) = delete;
+
+    // 查找并标记为最近使用，计入命中或未命中
+    Entry* find(std::string_view source);
+    // 插入新条目（调用前find()未命中），必要时淘汰最久未用的条目
+    Entry& insert(std::string source);
+    // 丢弃条目（例如exec的代码解析失败），不计入淘汰
+    void erase(Entry& entry);
+
+    size_t size() const { return entries.size(); }
+    size_t capacity() const { return limit; }
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+    size_t evictions() const { return evictionCount; }
+
+    static constexpr size_t kDefaultCapacity = 128;
+
+private:
+    size_t limit;
+    std::list<Entry> entries;  // 最近使用的在前
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;  // 键指向条目自己的source
+    size_t hitCount = 0;
+    size_t missCount = 0;
+    size_t evictionCount = 0;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "compiler.h"
+#include <cstring>
+#include <stdexcept>
+
+void CodeObject::remapSlots(const std::vector<uint32_t>& slots) {
+    for (auto& inst : code) {
+        if (inst.usesSlot()) inst.a = slots[inst.a];
+    }
+}
+
+std::unique_ptr<CodeObject> CodeObject::clone() const {
+    auto copy = std::make_unique<CodeObject>();
+    copy->code = code;
+    copy->lines = lines;
+    copy->maxStackDepth = maxStackDepth;
+    copy->constants.reserve(constants.size());
+    for (const Value& constant : constants) {
+        copy->constants.push_back(constant.clone());
+    }
+    return copy;
+}
+
+Compiler::Compiler() : code(nullptr), stackDepth(0), line(0) {}
+
+void Compiler::adjustStack(int delta) {
+    stackDepth = (size_t)((long long)stackDepth + delta);
+    if (stackDepth > code->maxStackDepth) {
+        code->maxStackDepth = stackDepth;
+    }
+}
+
+void Compiler::emit(OpCode op, uint32_t a, uint16_t b) {
+    code->code.emplace_back(op, a, b);
+    code->lines.push_back((uint32_t)line);
+
+    // 记录栈深度，虚拟机据此一次性分配值栈
+    const Instruction& inst = code->code.back();
+    adjustStack((int)inst.stackOutputs() - (int)inst.stackInputs());
+}
+
+uint32_t Compiler::addConstant(Value value) {
+    uint32_t next = (uint32_t)code->constants.size();
+    if (value.type == Value::Type::STRING) {
+        // 键指向常量自己的负载，常量数组扩容时负载不移动
+        auto found = stringConstants.emplace(value.stringValue(), next);
+        if (!found.second) return found.first->second;
+    } else if (value.type == Value::Type::NUMBER) {
+        // 按位比较，0.0和-0.0各占一个常量
+        uint64_t bits;
+        std::memcpy(&bits, &value.number, sizeof(bits));
+        auto found = numberConstants.emplace(bits, next);
+        if (!found.second) return found.first->second;
+    }
+    code->constants.push_back(std::move(value));
+    return next;
+}
+
+void Compiler::compileExpression(const ExprNode* expr) {
+    switch (expr->kind) {
+        case NodeKind::LITERAL: {
+            auto literal = static_cast<const LiteralExpr*>(expr);
+            switch (literal->type) {
+                case TokenType::NUMBER:
+                    emit(OpCode::LOAD_CONST, addConstant(Value(literal->number)));
+                    break;
+                case TokenType::TRUE:
+                    emit(OpCode::LOAD_CONST, addConstant(Value(true)));
+                    break;
+                case TokenType::FALSE:
+                    emit(OpCode::LOAD_CONST, addConstant(Value(false)));
+                    break;
+                case TokenType::STRING:
+                default:
+                    emit(OpCode::LOAD_CONST, addConstant(literal->constant ? *literal->constant : Value(literal->value)));
+                    break;
+            }
+            break;
+        }
+        case NodeKind::LIST: {
+            auto list = static_cast<const ListExpr*>(expr);
+            for (const auto& elem : list->elements) {
+                compileExpression(elem);
+            }
+            emit(OpCode::BUILD_LIST, (uint32_t)list->elements.size());
+            break;
+        }
+        case NodeKind::INDEX: {
+            auto index = static_cast<const IndexExpr*>(expr);
+            auto container = nodeCast<const IdentifierExpr>(index->array);
+            if (index->borrow && container && container->slot >= 0) {
+                // 下标没有副作用，直接在槽位上取元素，不把容器压栈
+                compileExpression(index->index);
+                emit(OpCode::INDEX_FAST, (uint32_t)container->slot);
+            } else {
+                compileExpression(index->array);
+                compileExpression(index->index);
+                emit(OpCode::BINARY_INDEX);
+            }
+            break;
+        }
+        case NodeKind::SLICE: {
+            auto slice = static_cast<const SliceExpr*>(expr);
+            compileExpression(slice->array);
+            // 省略的边界压入None
+            if (slice->start) {
+                compileExpression(slice->start);
+            } else {
+                emit(OpCode::LOAD_CONST, addConstant(Value()));
+            }
+            if (slice->stop) {
+                compileExpression(slice->stop);
+            } else {
+                emit(OpCode::LOAD_CONST, addConstant(Value()));
+            }
+            emit(OpCode::BINARY_SLICE);
+            break;
+        }
+        case NodeKind::FSTRING:
+            compileFString(static_cast<const FStringExpr*>(expr));
+            break;
+        case NodeKind::IDENTIFIER:
+            emit(OpCode::LOAD_FAST, (uint32_t)static_cast<const IdentifierExpr*>(expr)->slot);
+            break;
+        case NodeKind::BINARY: {
+            auto binary = static_cast<const BinaryExpr*>(expr);
+            compileExpression(binary->left);
+            auto constant = nodeCast<const LiteralExpr>(binary->right);
+            if (constant && constant->type == TokenType::NUMBER) {
+                // x + 1、n % 2这类右边是数字字面量的运算合成一条指令
+                emit(OpCode::BINARY_CONST, addConstant(Value(constant->number)), (uint16_t)binary->op);
+            } else {
+                compileExpression(binary->right);
+                switch (binary->op) {
+                    case TokenType::PLUS: emit(OpCode::BINARY_ADD); break;
+                    case TokenType::MINUS: emit(OpCode::BINARY_SUB); break;
+                    case TokenType::MULTIPLY: emit(OpCode::BINARY_MUL); break;
+                    case TokenType::DIVIDE: emit(OpCode::BINARY_DIV); break;
+                    case TokenType::MODULO: emit(OpCode::BINARY_MOD); break;
+                    default: emit(OpCode::BINARY_OP, (uint32_t)binary->op); break;
+                }
+            }
+            break;
+        }
+        case NodeKind::CALL:
+            compileCall(static_cast<const CallExpr*>(expr));
+            break;
+        case NodeKind::METHOD_CALL: {
+            auto methodCall = static_cast<const MethodCallExpr*>(expr);
+            compileExpression(methodCall->object);
+            for (const auto& arg : methodCall->arguments) {
+                compileExpression(arg);
+            }
+            emit(OpCode::CALL_METHOD, addConstant(Value(methodCall->method)),
+                 (uint16_t)methodCall->arguments.size());
+            break;
+        }
+        default:
+            emit(OpCode::LOAD_CONST, addConstant(Value()));
+            break;
+    }
+}
+
+void Compiler::compileFString(const FStringExpr* fstring) {
+    for (size_t i = 0; i < fstring->segment_count; i++) {
+        const FStringSegment& segment = fstring->segments[i];
+        auto identifier = nodeCast<const IdentifierExpr>(segment.expr);
+        if (!segment.expr) {
+            emit(OpCode::LOAD_CONST, addConstant(Value(segment.text)));
+        } else if (identifier) {
+            // 变量有没有赋值到执行时才知道（可能由exec()或嵌入接口设置）
+            emit(OpCode::LOAD_FORMAT_FAST, (uint32_t)identifier->slot);
+        } else {
+            compileExpression(segment.expr);
+        }
+    }
+
+    // 只有一段字面文本时不需要拼接
+    bool single_literal = fstring->segment_count == 1 && !fstring->segments[0].expr;
+    if (fstring->segment_count == 0) {
+        emit(OpCode::LOAD_CONST, addConstant(Value(std::string())));
+    } else if (!single_literal) {
+        emit(OpCode::BUILD_STRING, (uint32_t)fstring->segment_count);
+    }
+}
+
+void Compiler::compileCall(const CallExpr* call) {
+    auto callee = nodeCast<const IdentifierExpr>(call->callee);
+    if (!callee) {
+        throw std::runtime_error("Only named functions can be called");
+    }
+
+    for (const auto& arg : call->arguments) {
+        compileExpression(arg);
+    }
+
+    uint16_t argc = (uint16_t)call->arguments.size();
+    if (call->builtin != Builtin::NONE) {
+        emit(OpCode::CALL_BUILTIN, (uint32_t)call->builtin, argc);
+    } else {
+        emit(OpCode::CALL_FAST, (uint32_t)callee->slot, argc);
+    }
+}
+
+void Compiler::compileStatement(const StmtNode* stmt) {
+    line = stmt->line;
+    switch (stmt->kind) {
+        case NodeKind::PRINT: {
+            auto printStmt = static_cast<const PrintStmt*>(stmt);
+            for (const auto& expr : printStmt->expressions) {
+                compileExpression(expr);
+            }
+            emit(OpCode::PRINT, (uint32_t)printStmt->expressions.size());
+            break;
+        }
+        case NodeKind::ASSIGN: {
+            auto assignStmt = static_cast<const AssignStmt*>(stmt);
+            if (assignStmt->append) {
+                // 右边不会改写变量，先算右边再读变量和原来的顺序等价
+                compileExpression(static_cast<const BinaryExpr*>(assignStmt->value)->right);
+                emit(OpCode::INPLACE_ADD_FAST, (uint32_t)assignStmt->slot);
+            } else {
+                compileExpression(assignStmt->value);
+                emit(OpCode::STORE_FAST, (uint32_t)assignStmt->slot);
+            }
+            break;
+        }
+        case NodeKind::WITH: {
+            auto withStmt = static_cast<const WithStmt*>(stmt);
+            bool hasVar = !withStmt->optional_vars.empty();
+            uint32_t var = hasVar ? (uint32_t)withStmt->optional_slot : 0;
+
+            // 上下文对象在with语句体执行期间留在栈上，退出时由EXIT_WITH关闭
+            emit(OpCode::SETUP_WITH);
+            compileExpression(withStmt->context_expr);
+            emit(OpCode::ENTER_WITH, var, hasVar ? 1 : 0);
+            for (const auto& bodyStmt : withStmt->body) {
+                compileStatement(bodyStmt);
+            }
+            // 关闭上下文对象算在with语句自己的行上
+            line = withStmt->line;
+            emit(OpCode::EXIT_WITH, var, hasVar ? 1 : 0);
+            break;
+        }
+        case NodeKind::EXPR_STMT:
+            compileExpression(static_cast<const ExprStmt*>(stmt)->expression);
+            emit(OpCode::PRINT_EXPR);
+            break;
+        default:
+            break;
+    }
+}
+
+std::unique_ptr<CodeObject> Compiler::compile(const StmtList& statements) {
+    auto result = std::make_unique<CodeObject>();
+    code = result.get();
+    stackDepth = 0;
+    stringConstants.clear();
+    numberConstants.clear();
+
+    for (const auto& stmt : statements) {
+        compileStatement(stmt);
+    }
+    emit(OpCode::HALT);
+
+    code = nullptr;
+    return result;
+}
+
+std::unique_ptr<CodeObject> Compiler::compileEval(const ExprNode* expr) {
+    auto result = std::make_unique<CodeObject>();
+    code = result.get();
+    stackDepth = 0;
+    stringConstants.clear();
+    numberConstants.clear();
+    line = expr->line;
+
+    compileExpression(expr);
+    emit(OpCode::RETURN_VALUE);
+
+    code = nullptr;
+    return result;
+}
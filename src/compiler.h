@@ -0,0 +1,175 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "parser.h"
+#include "executor.h"
+#include "methods.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 字节码指令表（顺序即虚拟机分发表的顺序）
+#define CPPYTHON_OPCODES(X) \
+    X(LOAD_CONST)     /* a = 常量索引 */            \
+    X(LOAD_FAST)      /* a = 变量槽位 */            \
+    X(LOAD_FORMAT_FAST) /* a = 变量槽位：f-string里的变量名，未赋值时得到文本{name} */ \
+    X(STORE_FAST)     /* a = 变量槽位 */            \
+    X(INPLACE_ADD_FAST) /* a = 变量槽位：slot = slot + 栈顶，字符串原地追加 */ \
+    X(POP_TOP)                                      \
+    X(BUILD_LIST)     /* a = 元素数量 */            \
+    X(BINARY_INDEX)                                 \
+    X(INDEX_FAST)     /* a = 容器的变量槽位，栈顶是下标 */ \
+    X(BINARY_SLICE)   /* 栈：容器, 起点, 终点 */    \
+    X(BINARY_ADD)                                   \
+    X(BINARY_SUB)                                   \
+    X(BINARY_MUL)                                   \
+    X(BINARY_DIV)                                   \
+    X(BINARY_MOD)                                   \
+    X(BINARY_OP)      /* a = TokenType（比较等） */ \
+    X(BINARY_CONST)   /* a = 数字常量索引, b = TokenType：右边是数字字面量 */ \
+    X(BUILD_STRING)   /* a = 片段数量 */            \
+    X(CALL_BUILTIN)   /* a = Builtin编号, b = 参数数量 */ \
+    X(CALL_FAST)      /* a = 变量槽位, b = 参数数量 */    \
+    X(CALL_METHOD)    /* a = 方法名常量索引, b = 参数数量 */ \
+    X(PRINT)          /* a = 参数数量 */            \
+    X(PRINT_EXPR)                                   \
+    X(SETUP_WITH)                                   \
+    X(ENTER_WITH)     /* a = 变量槽位，b = 是否有as变量 */ \
+    X(EXIT_WITH)      /* a = 变量槽位，b = 是否有as变量 */ \
+    X(RETURN_VALUE)                                 \
+    X(HALT)
+
+enum class OpCode : uint8_t {
+#define CPPYTHON_OPCODE_ENUM(name) name,
+    CPPYTHON_OPCODES(CPPYTHON_OPCODE_ENUM)
+#undef CPPYTHON_OPCODE_ENUM
+};
+
+struct Instruction {
+    OpCode op;
+    uint16_t b;
+    uint32_t a;
+
+    Instruction(OpCode o, uint32_t arg = 0, uint16_t arg2 = 0) : op(o), b(arg2), a(arg) {}
+
+    // 操作数a是否为变量槽位
+    bool usesSlot() const {
+        switch (op) {
+            case OpCode::LOAD_FAST:
+            case OpCode::LOAD_FORMAT_FAST:
+            case OpCode::STORE_FAST:
+            case OpCode::CALL_FAST:
+            case OpCode::INDEX_FAST:
+            case OpCode::INPLACE_ADD_FAST:
+                return true;
+            case OpCode::ENTER_WITH:
+            case OpCode::EXIT_WITH:
+                return b != 0;
+            default:
+                return false;
+        }
+    }
+
+    // 指令从栈顶取走的值的数量（ENTER_WITH只读取栈顶，也算一个，和输出的一个抵消）
+    size_t stackInputs() const {
+        switch (op) {
+            case OpCode::STORE_FAST:
+            case OpCode::INPLACE_ADD_FAST:
+            case OpCode::POP_TOP:
+            case OpCode::INDEX_FAST:
+            case OpCode::BINARY_CONST:
+            case OpCode::PRINT_EXPR:
+            case OpCode::ENTER_WITH:
+            case OpCode::EXIT_WITH:
+            case OpCode::RETURN_VALUE:
+                return 1;
+            case OpCode::BINARY_INDEX:
+            case OpCode::BINARY_ADD:
+            case OpCode::BINARY_SUB:
+            case OpCode::BINARY_MUL:
+            case OpCode::BINARY_DIV:
+            case OpCode::BINARY_MOD:
+            case OpCode::BINARY_OP:
+                return 2;
+            case OpCode::BINARY_SLICE:
+                return 3;
+            case OpCode::BUILD_LIST:
+            case OpCode::BUILD_STRING:
+            case OpCode::PRINT:
+                return a;
+            case OpCode::CALL_BUILTIN:
+            case OpCode::CALL_FAST:
+                return b;
+            case OpCode::CALL_METHOD:
+                return (size_t)b + 1;  // 还有self
+            default:
+                return 0;
+        }
+    }
+
+    // 指令压入栈的值的数量（0或1）
+    size_t stackOutputs() const {
+        switch (op) {
+            case OpCode::STORE_FAST:
+            case OpCode::INPLACE_ADD_FAST:
+            case OpCode::POP_TOP:
+            case OpCode::PRINT:
+            case OpCode::PRINT_EXPR:
+            case OpCode::SETUP_WITH:
+            case OpCode::EXIT_WITH:
+            case OpCode::RETURN_VALUE:
+            case OpCode::HALT:
+                return 0;
+            default:
+                return 1;
+        }
+    }
+};
+
+// 编译后的代码对象：扁平的指令数组加常量池
+// 变量以槽位编号访问，槽位由Resolver在编译前分配
+struct CodeObject {
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<uint32_t> lines;  // 每条指令所属语句的行号（--profile使用）
+    size_t maxStackDepth = 0;
+    // CALL_METHOD的内联缓存，按方法名常量的下标索引（同名的调用点共用一项）；
+    // 是执行状态而不是代码的一部分，虚拟机第一次执行时分配，clone()不复制
+    mutable std::vector<MethodCache> methodCaches;
+
+    // 换到另一个符号表执行：槽位i改写为slots[i]
+    void remapSlots(const std::vector<uint32_t>& slots);
+    // 常量深拷贝的副本，和原对象不共享任何引用计数，可以交给另一个线程
+    std::unique_ptr<CodeObject> clone() const;
+};
+
+// 把Parser::parse()产生的AST降级为字节码
+class Compiler {
+private:
+    CodeObject* code;
+    size_t stackDepth;
+    int line;  // 正在编译的语句的行号
+    // 常量去重：相同的字符串和数字在常量池里只出现一次
+    std::unordered_map<std::string_view, uint32_t> stringConstants;
+    std::unordered_map<uint64_t, uint32_t> numberConstants;
+
+    void emit(OpCode op, uint32_t a = 0, uint16_t b = 0);
+    void adjustStack(int delta);
+    uint32_t addConstant(Value value);
+
+    void compileStatement(const StmtNode* stmt);
+    void compileExpression(const ExprNode* expr);
+    void compileCall(const CallExpr* call);
+    void compileFString(const FStringExpr* fstring);
+
+public:
+    Compiler();
+    std::unique_ptr<CodeObject> compile(const StmtList& statements);
+    // 编译单个表达式（eval使用），结果由RETURN_VALUE返回
+    std::unique_ptr<CodeObject> compileEval(const ExprNode* expr);
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "embed.h"
+#include "compiler.h"
+#include "executor.h"
+#include "optimizer.h"
+#include "output.h"
+#include "parser.h"
+#include "resolver.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+    constexpr size_t kInitialPrune = 64;
+}
+
+CompiledScript::Data::~Data() = default;
+
+const std::string& CompiledScript::name() const {
+    static const std::string empty;
+    return data ? data->name : empty;
+}
+
+EmbeddedInterpreter::EmbeddedInterpreter()
+    : output(std::make_unique<OutputBuffer>(stdout)),
+      executor(std::make_unique<Executor>(false)), pruneAt(kInitialPrune) {
+    executor->setOutput(output.get());
+}
+
+EmbeddedInterpreter::~EmbeddedInterpreter() = default;
+
+CompiledScript EmbeddedInterpreter::compile(std::string_view source, std::string name) {
+    // 编译结果不引用语法树和源码，编译单元用完即释放
+    CompilationUnit unit;
+    unit.parse(source);
+    Optimizer optimizer(unit.arena);
+    optimizer.optimize(unit.statements);
+
+    // 每个脚本有自己的符号表，执行时再映射到解释器实例的槽位
+    SymbolTable symbols;
+    Resolver resolver(symbols);
+    resolver.resolve(unit.statements);
+    Compiler compiler;
+
+    auto data = std::make_shared<CompiledScript::Data>();
+    data->name = std::move(name);
+    data->code = compiler.compile(unit.statements);
+    data->names.reserve(symbols.size());
+    for (size_t i = 0; i < symbols.size(); i++) {
+        data->names.push_back(symbols.name((uint32_t)i));
+    }
+
+    CompiledScript script;
+    script.data = std::move(data);
+    return script;
+}
+
+const CodeObject& EmbeddedInterpreter::bind(const std::shared_ptr<const CompiledScript::Data>& script) {
+    Binding& binding = bindings[script.get()];
+    if (binding.script.lock() == script) {
+        return *binding.code;
+    }
+
+    // 第一次在这个实例上执行：按名字登记槽位。槽位分配只增不减，映射一直有效
+    SymbolTable& symbols = executor->symbolTable();
+    std::vector<uint32_t> slots(script->names.size());
+    bool identity = true;
+    for (size_t i = 0; i < slots.size(); i++) {
+        slots[i] = symbols.intern(script->names[i]);
+        identity = identity && slots[i] == i;
+    }
+    // 共享的字节码从不直接执行，其他线程上的实例可能同时在读它
+    binding.script = script;
+    binding.code = script->code->clone();
+    if (!identity) {
+        binding.code->remapSlots(slots);
+    }
+
+    // 丢掉已经销毁的脚本留下的映射
+    if (bindings.size() >= pruneAt) {
+        for (auto it = bindings.begin(); it != bindings.end();) {
+            it = it->second.script.expired() ? bindings.erase(it) : std::next(it);
+        }
+        pruneAt = std::max(kInitialPrune, bindings.size() * 2);
+    }
+    return *binding.code;
+}
+
+void EmbeddedInterpreter::run(const CompiledScript& script) {
+    if (!script.valid()) {
+        throw std::runtime_error("Cannot run an empty script");
+    }
+    const CodeObject& code = bind(script.data);
+    try {
+        executor->run(code);
+    } catch (...) {
+        output->flush();
+        throw;
+    }
+    output->flush();
+}
+
+void EmbeddedInterpreter::setOutput(std::string* buffer) {
+    output->redirect(buffer);
+}
+
+void EmbeddedInterpreter::setInput(std::istream* in) {
+    executor->setInput(in);
+}
+
+void EmbeddedInterpreter::reset() {
+    executor->reset();
+}
+
+bool EmbeddedInterpreter::get(std::string_view name, Value& value) const {
+    return executor->getVariable(name, value);
+}
+
+void EmbeddedInterpreter::set(std::string_view name, Value value) {
+    executor->setVariable(name, std::move(value));
+}
@@ -0,0 +1,99 @@
+#ifndef EMBED_H
+#define EMBED_H
+
+#include "value.h"
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class Executor;
+class OutputBuffer;
+struct CodeObject;
+
+// 嵌入接口：在C++程序里编译并反复执行脚本，不需要启动进程或读写文件
+//
+//     CompiledScript script = EmbeddedInterpreter::compile("y = x * 2");
+//     EmbeddedInterpreter interpreter;
+//     std::string output;
+//     interpreter.setOutput(&output);
+//     interpreter.set("x", Value(21.0));
+//     interpreter.run(script);
+//     Value y;
+//     interpreter.get("y", y);  // y.number == 42
+//
+// 脚本在虚拟机引擎上执行；执行出错时抛出std::runtime_error
+//
+// 线程：一个EmbeddedInterpreter同一时间只能在一个线程上使用；不同实例之间
+// 不共享任何可变状态，可以各自在自己的线程上执行同一个CompiledScript。
+// Value的引用计数不是原子的，在线程之间传递值时用Value::clone()；
+// 数字、字符串、布尔值、None、列表和字节串可以传递，文件对象不行
+
+// 编译好的脚本：不可变，拷贝只共享同一份字节码，可以在多个解释器实例
+// （包括不同线程上的实例）上执行
+class CompiledScript {
+public:
+    CompiledScript() = default;
+
+    bool valid() const { return data != nullptr; }
+    const std::string& name() const;
+
+private:
+    friend class EmbeddedInterpreter;
+
+    struct Data {
+        std::string name;
+        std::unique_ptr<CodeObject> code;
+        std::vector<std::string> names;  // 编译时的槽位 -> 变量名
+        ~Data();
+    };
+
+    std::shared_ptr<const Data> data;
+};
+
+// 一个独立的执行环境：变量、eval/exec缓存和输出目标都属于这个实例
+class EmbeddedInterpreter {
+public:
+    EmbeddedInterpreter();
+    ~EmbeddedInterpreter();
+    EmbeddedInterpreter(const EmbeddedInterpreter&) = delete;
+    EmbeddedInterpreter& operator=(const EmbeddedInterpreter&) = delete;
+
+    // 编译源码（源码不需要在编译后继续存在）
+    static CompiledScript compile(std::string_view source, std::string name = "<string>");
+
+    // 在当前环境中执行，变量在多次执行之间保留
+    void run(const CompiledScript& script);
+    // 清空所有变量，相当于换一个全新的环境，但不丢弃已经建立的槽位映射；
+    // 之后f-string里的这些变量重新显示为{name}
+    void reset();
+
+    // 直接读写变量，不经过字符串转换；变量还没有赋值（包括reset()之后）时get返回false
+    bool get(std::string_view name, Value& value) const;
+    void set(std::string_view name, Value value);
+
+    // run()期间的print输出追加到buffer中；nullptr表示写到标准输出
+    void setOutput(std::string* buffer);
+    // input()从in读取；nullptr表示input()总是返回空字符串，默认是std::cin
+    void setInput(std::istream* in);
+
+private:
+    // 脚本在本实例中的副本：常量是深拷贝，槽位已经映射到本实例的符号表，
+    // 执行时只修改本实例自己的引用计数
+    struct Binding {
+        std::weak_ptr<const CompiledScript::Data> script;
+        std::unique_ptr<CodeObject> code;
+    };
+
+    std::unique_ptr<OutputBuffer> output;
+    std::unique_ptr<Executor> executor;
+    std::unordered_map<const CompiledScript::Data*, Binding> bindings;
+    size_t pruneAt;
+
+    const CodeObject& bind(const std::shared_ptr<const CompiledScript::Data>& script);
+};
+
+#endif
@@ -1,43 +1,145 @@
 #include "executor.h"
 #include "parser.h"
 #include "utils.h"
+#include "compiler.h"
+#include "vm.h"
+#include "optimizer.h"
+#include "output.h"
+#include "profiler.h"
+#include "kernels.h"
 #include <iostream>
-#include <sstream>
 #include <cstdio>
 #include <cmath>
-#include <regex>
-#include <fstream>
+#include <algorithm>
+#include <cstring>
 
-Executor::Executor(bool isInteractive) : interactiveMode(isInteractive) {
-    fastIO();
+namespace {
+    bool isNumeric(const Value& v) {
+        return v.type == Value::Type::NUMBER || v.type == Value::Type::BOOLEAN;
+    }
+
+    // <、>和min/max的比较：数字和布尔值按数值，字符串按字典序，其他组合和Python一样报错
+    bool lessThan(const Value& a, const Value& b, const char* symbol = "<") {
+        if (isNumeric(a) && isNumeric(b)) return a.toNumber() < b.toNumber();
+        if (a.type == Value::Type::STRING && b.type == Value::Type::STRING) {
+            return a.stringValue() < b.stringValue();
+        }
+        throw std::runtime_error(std::string("'") + symbol + "' not supported between these types");
+    }
+
+    // ==和!=：数字和布尔值按数值，列表逐项比较，文件对象比较是不是同一个，
+    // 类型不同的值不相等
+    bool equalValues(const Value& a, const Value& b) {
+        if (isNumeric(a) && isNumeric(b)) return a.toNumber() == b.toNumber();
+        if (a.type != b.type) return false;
+        switch (a.type) {
+            case Value::Type::STRING:
+                return a.stringValue() == b.stringValue();
+            case Value::Type::BYTES:
+                return a.bytesValue() == b.bytesValue();
+            case Value::Type::NONE:
+                return true;
+            case Value::Type::FILE_OBJECT:
+                return a.fileObject() == b.fileObject();
+            case Value::Type::LIST: {
+                size_t size = a.listSize();
+                if (size != b.listSize()) return false;
+                for (size_t i = 0; i < size; i++) {
+                    if (!equalValues(a.listItem(i), b.listItem(i))) return false;
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // 未赋值的变量读出的值
+    const Value kNone;
+
+    // 下标在范围内且元素逐项存放时返回元素地址；其他情况交给applyIndex
+    const Value* borrowIndex(const Value& container, const Value& index) {
+        if (container.type != Value::Type::LIST) return nullptr;
+        int i = (int)index.toNumber();
+        if (i < 0 || i >= (int)container.listSize()) return nullptr;
+        return container.listBorrow((size_t)i);
+    }
+
+    // 调用参数的临时数组：参数不多时直接放在栈上，只有超出定长部分才分配
+    class Arguments {
+    public:
+        static constexpr size_t kInline = 8;
+
+        explicit Arguments(size_t capacity) : items(fixed) {
+            if (capacity > kInline) {
+                CPPYTHON_STAT(argument_spills, 1);
+                spilled.resize(capacity);
+                items = spilled.data();
+            }
+        }
+
+        Arguments(const Arguments&) = delete;
+        Arguments& operator=(const Arguments&) = delete;
+
+        void push(Value value) { items[count++] = std::move(value); }
+        const Value* data() const { return items; }
+        size_t size() const { return count; }
+
+    private:
+        Value fixed[kInline];
+        std::vector<Value> spilled;
+        Value* items;
+        size_t count = 0;
+    };
+
+    // 逐项存放的值：取第一个最小（最大）的元素
+    Value extremeOf(const Value* items, size_t count, bool maximum) {
+        const Value* best = items;
+        for (size_t i = 1; i < count; i++) {
+            if (maximum ? lessThan(*best, items[i]) : lessThan(items[i], *best)) best = items + i;
+        }
+        return *best;
+    }
+}
+
+Executor::Executor(bool isInteractive)
+    : interactiveMode(isInteractive), engine(Engine::VM), profiler(nullptr),
+      output(&OutputBuffer::standardOutput()), input(&std::cin) {
 }
 
 Value Executor::evaluateExpression(const ExprNode* expr) {
-    if (auto literal = dynamic_cast<const LiteralExpr*>(expr)) {
-        return evaluateLiteral(literal);
-    } else if (auto list = dynamic_cast<const ListExpr*>(expr)) {
-        return evaluateList(list);
-    } else if (auto index = dynamic_cast<const IndexExpr*>(expr)) {
-        return evaluateIndex(index);
-    } else if (auto fstring = dynamic_cast<const FStringExpr*>(expr)) {
-        return evaluateFString(fstring);
-    } else if (auto identifier = dynamic_cast<const IdentifierExpr*>(expr)) {
-        return evaluateIdentifier(identifier);
-    } else if (auto binary = dynamic_cast<const BinaryExpr*>(expr)) {
-        return evaluateBinary(binary);
-    } else if (auto call = dynamic_cast<const CallExpr*>(expr)) {
-        return evaluateCall(call);
+    CPPYTHON_STAT(ast_dispatches, 1);
+    switch (expr->kind) {
+        case NodeKind::LITERAL:
+            return evaluateLiteral(static_cast<const LiteralExpr*>(expr));
+        case NodeKind::LIST:
+            return evaluateList(static_cast<const ListExpr*>(expr));
+        case NodeKind::INDEX:
+            return evaluateIndex(static_cast<const IndexExpr*>(expr));
+        case NodeKind::SLICE:
+            return evaluateSlice(static_cast<const SliceExpr*>(expr));
+        case NodeKind::FSTRING:
+            return evaluateFString(static_cast<const FStringExpr*>(expr));
+        case NodeKind::IDENTIFIER:
+            return evaluateIdentifier(static_cast<const IdentifierExpr*>(expr));
+        case NodeKind::BINARY:
+            return evaluateBinary(static_cast<const BinaryExpr*>(expr));
+        case NodeKind::CALL:
+            return evaluateCall(static_cast<const CallExpr*>(expr));
+        case NodeKind::METHOD_CALL:
+            return evaluateMethodCall(static_cast<const MethodCallExpr*>(expr));
+        default:
+            return Value();
     }
-    
-    return Value();
 }
 
 Value Executor::evaluateLiteral(const LiteralExpr* literal) {
     switch (literal->type) {
         case TokenType::NUMBER:
-            return Value(std::stod(literal->value));
+            return Value(literal->number);
         case TokenType::STRING:
-            return Value(literal->value);
+            // 驻留过的字面量只增加引用计数，不再分配
+            return literal->constant ? *literal->constant : Value(literal->value);
         case TokenType::TRUE:
             return Value(true);
         case TokenType::FALSE:
@@ -50,29 +152,115 @@ Value Executor::evaluateLiteral(const LiteralExpr* literal) {
 // 添加列表评估
 Value Executor::evaluateList(const ListExpr* list) {
     std::vector<Value> elements;
+    elements.reserve(list->elements.size());
     for (const auto& elem : list->elements) {
-        elements.push_back(evaluateExpression(elem.get()));
+        elements.push_back(evaluateExpression(elem));
     }
-    return Value(elements);
+    return Value(std::move(elements));
+}
+
+// 标识符和下标链按引用求值，容器和元素都不复制；产生新值时放进scratch
+const Value& Executor::evaluatePlace(const ExprNode* expr, Value& scratch) {
+    if (auto identifier = nodeCast<const IdentifierExpr>(expr)) {
+        CPPYTHON_STAT(slot_loads, 1);
+        return slotValue(identifier->slot);
+    }
+    auto index = nodeCast<const IndexExpr>(expr);
+    if (index && index->borrow) {
+        const Value& container = evaluatePlace(index->array, scratch);
+        Value idx = evaluateExpression(index->index);
+        if (const Value* element = borrowIndex(container, idx)) {
+            return *element;
+        }
+        // container可能就是scratch，先算出结果再覆盖
+        Value result = applyIndex(container, idx);
+        scratch = std::move(result);
+        return scratch;
+    }
+    scratch = evaluateExpression(expr);
+    return scratch;
 }
 
 // 添加索引评估
 Value Executor::evaluateIndex(const IndexExpr* index) {
-    Value array = evaluateExpression(index->array.get());
-    Value idx = evaluateExpression(index->index.get());
-    
+    if (index->borrow) {
+        Value scratch;
+        const Value& element = evaluatePlace(index, scratch);
+        if (&element == &scratch) return scratch;
+        return element;
+    }
+    Value array = evaluateExpression(index->array);
+    Value idx = evaluateExpression(index->index);
+    return applyIndex(array, idx);
+}
+
+Value Executor::evaluateSlice(const SliceExpr* slice) {
+    Value scratch;
+    Value copy;
+    // 边界里有调用时先把容器取出来，保持求值顺序
+    const Value& array = slice->borrow ? evaluatePlace(slice->array, scratch)
+                                       : (copy = evaluateExpression(slice->array));
+    Value start = slice->start ? evaluateExpression(slice->start) : Value();
+    Value stop = slice->stop ? evaluateExpression(slice->stop) : Value();
+    return applySlice(array, start, stop);
+}
+
+Value Executor::applyIndex(const Value& array, const Value& idx) {
     if (array.type == Value::Type::LIST) {
         int index_val = (int)idx.toNumber();
-        if (index_val >= 0 && index_val < (int)array.list_value.size()) {
-            return array.list_value[index_val];
+        if (index_val >= 0 && index_val < (int)array.listSize()) {
+            return array.listItem((size_t)index_val);
         } else {
             throw std::runtime_error("Index out of range");
         }
     }
     
+    if (array.type == Value::Type::BYTES) {
+        // 直接在映射上取字节，负数从末尾计
+        std::string_view data = array.bytesValue();
+        long long index_val = (long long)idx.toNumber();
+        if (index_val < 0) index_val += (long long)data.size();
+        if (index_val >= 0 && index_val < (long long)data.size()) {
+            return Value((double)(unsigned char)data[(size_t)index_val]);
+        }
+        throw std::runtime_error("Index out of range");
+    }
+    
     throw std::runtime_error("Indexing not supported for this type");
 }
 
+Value Executor::applySlice(const Value& container, const Value& start, const Value& stop) {
+    size_t length;
+    switch (container.type) {
+        case Value::Type::LIST: length = container.listSize(); break;
+        case Value::Type::STRING: length = container.stringValue().size(); break;
+        case Value::Type::BYTES: length = container.bytesValue().size(); break;
+        default:
+            throw std::runtime_error("Slicing not supported for this type");
+    }
+    
+    // 与Python相同：None表示到头，负数从末尾计，越界时截断
+    auto bound = [length](const Value& v, size_t fallback) {
+        if (v.type == Value::Type::NONE) return fallback;
+        long long n = (long long)v.toNumber();
+        if (n < 0) n += (long long)length;
+        if (n < 0) return (size_t)0;
+        return std::min((size_t)n, length);
+    };
+    size_t first = bound(start, 0);
+    size_t last = std::max(first, bound(stop, length));
+    
+    switch (container.type) {
+        case Value::Type::LIST:
+            return container.listSlice(first, last);
+        case Value::Type::STRING:
+            return Value(container.stringValue().substr(first, last - first));
+        default:
+            // 字节串切片仍然指向同一块映射
+            return container.bytesSlice(first, last - first);
+    }
+}
+
 Value Executor::parseAndEvaluateSimpleExpression(const std::string& expr_str) {
     // 去除空白字符
     std::string expr = expr_str;
@@ -86,35 +274,22 @@ Value Executor::parseAndEvaluateSimpleExpression(const std::string& expr_str) {
     if (std::all_of(expr.begin(), expr.end(), [](char c) { 
         return std::isdigit(c) || c == '.'; 
     })) {
-        try {
-            return Value(std::stod(expr));
-        } catch (...) {
-            return Value(expr);
+        double number;
+        if (Utils::parseNumber(expr, number)) {
+            return Value(number);
         }
+        return Value(expr);
     }
     
     // 简单的变量
     if (std::all_of(expr.begin(), expr.end(), [](char c) { 
         return std::isalnum(c) || c == '_'; 
     })) {
-        auto it = variables.find(expr);
-        if (it != variables.end()) {
-            const Value& val = it->second;
-            switch (val.type) {
-                case Value::Type::NUMBER:
-                    return Value(val.number);
-                case Value::Type::STRING:
-                    return Value(val.string_value);
-                case Value::Type::BOOLEAN:
-                    return Value(val.boolean);
-                case Value::Type::LIST:
-                    return Value(val.list_value);
-                case Value::Type::FILE_OBJECT:
-                    return Value(); // 文件对象不能简单复制
-                case Value::Type::NONE:
-                default:
-                    return Value();
+        if (Value* var = findVariable(expr)) {
+            if (var->type == Value::Type::FILE_OBJECT) {
+                return Value(); // 文件对象不在f-string中展开
             }
+            return *var;
         }
         return Value("{" + expr + "}");
     }
@@ -178,124 +353,160 @@ Value Executor::parseAndEvaluateSimpleExpression(const std::string& expr_str) {
     return Value("{" + expr_str + "}");
 }
 
+// f-string中的文件对象显示为None
+void Executor::appendFStringValue(std::string& out, const Value& value) {
+    if (value.type == Value::Type::FILE_OBJECT) {
+        out += "None";
+    } else {
+        value.appendTo(out);
+    }
+}
+
+Value Executor::buildString(const Value* parts, size_t count) {
+    size_t length = 0;
+    for (size_t i = 0; i < count; i++) {
+        length += parts[i].type == Value::Type::STRING ? parts[i].stringValue().size() : 16;
+    }
+    
+    std::string result;
+    result.reserve(length);
+    for (size_t i = 0; i < count; i++) {
+        appendFStringValue(result, parts[i]);
+    }
+    return Value(std::move(result));
+}
+
 Value Executor::evaluateFString(const FStringExpr* fstring) {
-    std::string template_str = fstring->template_string;
-    std::string result = "";
-    
-    size_t pos = 0;
-    while (pos < template_str.length()) {
-        if (template_str[pos] == '\\') {
-            // 处理转义字符
-            if (pos + 1 < template_str.length()) {
-                pos++;
-                switch (template_str[pos]) {
-                    case 'n': result += '\n'; break;
-                    case 'r': result += '\r'; break;
-                    case 't': result += '\t'; break;
-                    case 'b': result += '\b'; break;
-                    case 'f': result += '\f'; break;
-                    case 'v': result += '\v'; break;
-                    case '\\': result += '\\'; break;
-                    case '"': result += '"'; break;
-                    case '\'': result += '\''; break;
-                    case '{': result += '{'; break; // 转义大括号
-                    case '}': result += '}'; break; // 转义大括号
-                    default: result += template_str[pos]; break;
-                }
-            } else {
-                result += template_str[pos];
-            }
-            pos++;
-        } else if (template_str[pos] == '{') {
-            // 找到表达式开始
-            size_t expr_start = pos + 1;
-            int brace_count = 1;
-            size_t expr_end = expr_start;
-            
-            // 找到匹配的右括号
-            while (expr_end < template_str.length() && brace_count > 0) {
-                if (template_str[expr_end] == '{') {
-                    brace_count++;
-                } else if (template_str[expr_end] == '}') {
-                    brace_count--;
-                }
-                if (brace_count > 0) expr_end++;
-            }
-            
-            if (brace_count == 0) {
-                // 提取表达式
-                std::string expr_str = template_str.substr(expr_start, expr_end - expr_start);
-                
-                // 解析并评估表达式
-                Value expr_value = parseAndEvaluateSimpleExpression(expr_str);
-                result += expr_value.toString();
-                
-                pos = expr_end + 1;
-            } else {
-                result += template_str[pos];
-                pos++;
-            }
+    std::string result;
+    result.reserve(fstring->literal_length + 16 * fstring->segment_count);
+    
+    for (size_t i = 0; i < fstring->segment_count; i++) {
+        const FStringSegment& segment = fstring->segments[i];
+        if (!segment.expr) {
+            result += segment.text;
+            continue;
+        }
+        
+        auto identifier = nodeCast<const IdentifierExpr>(segment.expr);
+        if (!identifier) {
+            appendFStringValue(result, evaluateExpression(segment.expr));
+        } else if (frame[identifier->slot].isBound()) {
+            CPPYTHON_STAT(slot_loads, 1);
+            appendFStringValue(result, frame[identifier->slot]);
         } else {
-            result += template_str[pos];
-            pos++;
+            // 未赋值的变量原样显示
+            result += '{';
+            result += identifier->name;
+            result += '}';
         }
     }
     
-    return Value(result);
+    return Value(std::move(result));
 }
 
 Value Executor::evaluateIdentifier(const IdentifierExpr* identifier) {
-    auto it = variables.find(identifier->name);
-    if (it != variables.end()) {
-        return Value(it->second); // 使用拷贝构造函数
-    }
-    return Value(); // None
+    CPPYTHON_STAT(slot_loads, 1);
+    return slotValue(identifier->slot); // 拷贝只增加引用计数
 }
 
 Value Executor::evaluateBinary(const BinaryExpr* binary) {
-    Value left = evaluateExpression(binary->left.get());
-    Value right = evaluateExpression(binary->right.get());
-    
-    switch (binary->op) {
+    if (binary->misses < BinaryExpr::kPolymorphic) {
+        // 至今多数是数字的运算点：变量直接在槽位上读，两边都是数字时不经过类型分派
+        Value leftValue, rightValue;
+        const Value& left = binary->left_slot >= 0 ? slotValue(binary->left_slot)
+                                                   : (leftValue = evaluateExpression(binary->left));
+        const Value& right = binary->right_slot >= 0 ? slotValue(binary->right_slot)
+                                                     : (rightValue = evaluateExpression(binary->right));
+        if (left.type == Value::Type::NUMBER && right.type == Value::Type::NUMBER) {
+            return applyNumbers(binary->op, left.number, right.number);
+        }
+        binary->misses++;
+        if (binary->op == TokenType::PLUS && left.type == Value::Type::STRING && &left == &leftValue) {
+            leftValue.appendText(right);
+            return leftValue;
+        }
+        return applyBinary(binary->op, left, right);
+    }
+
+    Value left = evaluateExpression(binary->left);
+    Value right = evaluateExpression(binary->right);
+    if (binary->op == TokenType::PLUS && left.type == Value::Type::STRING) {
+        // a + b + c里左边是上一步的临时串，直接在上面追加
+        left.appendText(right);
+        return left;
+    }
+    return applyBinary(binary->op, left, right);
+}
+
+Value Executor::applyBinary(TokenType op, const Value& left, const Value& right) {
+    if (left.type == Value::Type::NUMBER && right.type == Value::Type::NUMBER) {
+        return applyNumbers(op, left.number, right.number);
+    }
+    CPPYTHON_STAT(binary_generic, 1);
+    switch (op) {
         case TokenType::PLUS:
             if (left.type == Value::Type::STRING || right.type == Value::Type::STRING) {
-                return Value(left.toString() + right.toString());
+                std::string result;
+                left.appendTo(result);
+                right.appendTo(result);
+                return Value(std::move(result));
             } else if (left.type == Value::Type::LIST && right.type == Value::Type::LIST) {
                 // 列表连接
-                std::vector<Value> result = left.list_value;
-                result.insert(result.end(), right.list_value.begin(), right.list_value.end());
-                return Value(result);
+                return left.listConcat(right);
+            } else if (left.type == Value::Type::BYTES && right.type == Value::Type::BYTES) {
+                std::string joined(left.bytesValue());
+                joined += right.bytesValue();
+                return Value::bytes(std::move(joined));
             } else {
                 return Value(left.toNumber() + right.toNumber());
             }
         case TokenType::MINUS:
             return Value(left.toNumber() - right.toNumber());
         case TokenType::MULTIPLY:
+            // 列表乘整数是重复，和Python一样负数得到空列表
+            if (left.type == Value::Type::LIST || right.type == Value::Type::LIST) {
+                const Value& list = left.type == Value::Type::LIST ? left : right;
+                const Value& times = left.type == Value::Type::LIST ? right : left;
+                if (isNumeric(times)) {
+                    double n = std::trunc(times.toNumber());
+                    return list.listRepeat(n > 0 ? (size_t)n : 0);
+                }
+            }
             return Value(left.toNumber() * right.toNumber());
         case TokenType::DIVIDE:
             return Value(left.toNumber() / right.toNumber());
         case TokenType::MODULO:
             return Value(std::fmod(left.toNumber(), right.toNumber()));
+        case TokenType::EQUAL:
+            return Value(equalValues(left, right));
+        case TokenType::NOT_EQUAL:
+            return Value(!equalValues(left, right));
+        case TokenType::LESS:
+            return Value(lessThan(left, right));
+        case TokenType::GREATER:
+            return Value(lessThan(right, left, ">"));
         default:
             return Value();
     }
 }
 
 // 添加str()函数支持
-Value Executor::evaluateStr(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+Value Executor::evaluateStr(const Value* args, size_t argc) {
+    if (argc == 0) {
         return Value("");
     }
-    Value arg = evaluateExpression(arguments[0].get());
-    return Value(arg.toString());
+    if (args[0].type == Value::Type::STRING) {
+        return args[0];  // 字符串直接共享
+    }
+    return Value(args[0].toString());
 }
 
 // 添加repr()函数支持
-Value Executor::evaluateRepr(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+Value Executor::evaluateRepr(const Value* args, size_t argc) {
+    if (argc == 0) {
         return Value("''");
     }
-    Value arg = evaluateExpression(arguments[0].get());
+    const Value& arg = args[0];
     std::string str = arg.toString();
     // 简单的repr实现：为字符串添加引号
     if (arg.type == Value::Type::STRING) {
@@ -305,203 +516,313 @@ Value Executor::evaluateRepr(const std::vector<std::unique_ptr<ExprNode>>& argum
 }
 
 // 添加int()函数支持
-Value Executor::evaluateInt(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
-        return Value(0.0);
-    }
-    Value arg = evaluateExpression(arguments[0].get());
-    try {
-        return Value((double)(long long)arg.toNumber());
-    } catch (...) {
+Value Executor::evaluateInt(const Value* args, size_t argc) {
+    if (argc == 0) {
         return Value(0.0);
     }
+    // 向零取整；字符串经由Utils::parseNumber解析，不再依赖异常
+    // 加0.0把-0.5取整得到的负零变回0：整数没有负零
+    return Value(std::trunc(args[0].toNumber()) + 0.0);
 }
 
 // 添加float()函数支持
-Value Executor::evaluateFloat(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+Value Executor::evaluateFloat(const Value* args, size_t argc) {
+    if (argc == 0) {
         return Value(0.0);
     }
-    Value arg = evaluateExpression(arguments[0].get());
-    return Value(arg.toNumber());
+    return Value(args[0].toNumber());
 }
 
 // 添加bool()函数支持
-Value Executor::evaluateBool(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+Value Executor::evaluateBool(const Value* args, size_t argc) {
+    if (argc == 0) {
         return Value(false);
     }
-    Value arg = evaluateExpression(arguments[0].get());
-    return Value(arg.toBoolean());
+    return Value(args[0].toBoolean());
 }
 
 // 添加len()函数支持（支持列表）
-Value Executor::evaluateLen(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+Value Executor::evaluateLen(const Value* args, size_t argc) {
+    if (argc == 0) {
         return Value(0.0);
     }
-    Value arg = evaluateExpression(arguments[0].get());
+    const Value& arg = args[0];
     if (arg.type == Value::Type::LIST) {
-        return Value((double)arg.list_value.size());
+        return Value((double)arg.listSize());
+    }
+    if (arg.type == Value::Type::BYTES) {
+        return Value((double)arg.bytesValue().size());
+    }
+    if (arg.type == Value::Type::STRING) {
+        return Value((double)arg.stringValue().length());
     }
     std::string str = arg.toString();
     return Value((double)str.length());
 }
 
+// sum(list, start=0)：紧凑数字列表走向量化的累加
+Value Executor::evaluateSum(const Value* args, size_t argc) {
+    if (argc == 0 || args[0].type != Value::Type::LIST) {
+        throw std::runtime_error("sum() argument must be a list");
+    }
+    const Value& list = args[0];
+    double total = argc > 1 ? args[1].toNumber() : 0.0;
+    size_t count = list.listSize();
+    switch (list.listStorage()) {
+        case Value::ListStorage::NUMBERS:
+            return Value(total + Kernels::sum(list.listNumbers(), count));
+        case Value::ListStorage::BOOLEANS: {
+            const uint8_t* flags = list.listBooleans();
+            size_t ones = 0;
+            for (size_t i = 0; i < count; i++) ones += flags[i];
+            return Value(total + (double)ones);
+        }
+        default:
+            for (const Value* item = list.listBoxed(); item != list.listBoxed() + count; item++) {
+                if (!isNumeric(*item)) {
+                    throw std::runtime_error("unsupported operand type(s) for +: sum() needs numbers");
+                }
+                total += item->toNumber();
+            }
+            return Value(total);
+    }
+}
+
+// min(list)/min(a, b, ...)，max同理
+Value Executor::evaluateMinMax(const Value* args, size_t argc, bool maximum) {
+    const char* name = maximum ? "max" : "min";
+    if (argc == 0) {
+        throw std::runtime_error(std::string(name) + "() expected at least 1 argument");
+    }
+    if (argc > 1) {
+        return extremeOf(args, argc, maximum);
+    }
+    const Value& list = args[0];
+    if (list.type != Value::Type::LIST) {
+        throw std::runtime_error(std::string(name) + "() argument must be a list");
+    }
+    size_t count = list.listSize();
+    if (count == 0) {
+        throw std::runtime_error(std::string(name) + "() arg is an empty sequence");
+    }
+    switch (list.listStorage()) {
+        case Value::ListStorage::NUMBERS: {
+            const double* numbers = list.listNumbers();
+            return Value(maximum ? Kernels::max(numbers, count) : Kernels::min(numbers, count));
+        }
+        case Value::ListStorage::BOOLEANS: {
+            // max是“有没有True”，min是“有没有False”
+            bool found = std::memchr(list.listBooleans(), maximum ? 1 : 0, count) != nullptr;
+            return Value(maximum ? found : !found);
+        }
+        default:
+            return extremeOf(list.listBoxed(), count, maximum);
+    }
+}
+
+std::vector<std::pair<const char*, uint64_t>> Executor::statistics() const {
+    std::vector<std::pair<const char*, uint64_t>> result;
+    if (Stats::enabled()) {
+        for (size_t i = 0; i < Stats::kCounterCount; i++) {
+            auto counter = static_cast<Stats::Counter>(i);
+            result.emplace_back(Stats::name(counter), Stats::get(counter));
+        }
+    }
+    result.emplace_back("eval_cache_hits", evalCache.hits());
+    result.emplace_back("eval_cache_misses", evalCache.misses());
+    result.emplace_back("eval_cache_evictions", evalCache.evictions());
+    result.emplace_back("exec_cache_hits", execCache.hits());
+    result.emplace_back("exec_cache_misses", execCache.misses());
+    result.emplace_back("exec_cache_evictions", execCache.evictions());
+    return result;
+}
+
+// stats()返回[名字, 数值]列表，stats("名字")返回单个计数器
+Value Executor::evaluateStats(const Value* args, size_t argc) {
+    auto counters = statistics();
+    if (argc == 0) {
+        Value::List rows;
+        rows.reserve(counters.size());
+        for (const auto& counter : counters) {
+            rows.emplace_back(Value::List{Value(counter.first), Value((double)counter.second)});
+        }
+        return Value(std::move(rows));
+    }
+    
+    std::string name = args[0].toString();
+    for (const auto& counter : counters) {
+        if (name == counter.first) {
+            return Value((double)counter.second);
+        }
+    }
+    if (!Stats::enabled()) {
+        throw std::runtime_error("stats() counter not available: " + name +
+                                 " (interpreter built without CPPYTHON_STATS)");
+    }
+    throw std::runtime_error("stats() unknown counter: " + name);
+}
+
 // 添加open函数支持
-Value Executor::evaluateOpen(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+Value Executor::evaluateOpen(const Value* args, size_t argc) {
+    if (argc == 0) {
         throw std::runtime_error("open() missing required argument 'file'");
     }
     
     // 获取文件名
-    Value filename_value = evaluateExpression(arguments[0].get());
-    std::string filename = filename_value.toString();
+    std::string filename = args[0].toString();
     
     // 获取模式（默认为'r'）
     std::string mode = "r";
-    if (arguments.size() > 1) {
-        Value mode_value = evaluateExpression(arguments[1].get());
-        mode = mode_value.toString();
+    if (argc > 1) {
+        mode = args[1].toString();
     }
     
     // 检查是否为二进制模式
     bool is_binary = (mode.find('b') != std::string::npos);
     
-    // 创建文件对象
+    // 创建文件对象并打开真正的文件句柄
     auto file_obj = std::make_unique<Value::FileObject>(filename, mode, is_binary);
+    if (!file_obj->open()) {
+        throw std::runtime_error("Could not open file: " + filename);
+    }
     
     return Value(std::move(file_obj));
 }
 
-// 添加文件读取支持
-Value Executor::evaluateFileRead(const std::string& filename, bool is_binary) {
-    try {
-        std::ios::openmode open_mode = std::ios::in;
-        if (is_binary) {
-            open_mode |= std::ios::binary;
-        }
-        
-        std::ifstream file(filename, open_mode);
-        if (!file.is_open()) {
-            throw std::runtime_error("Could not open file for reading: " + filename);
-        }
-        
-        if (is_binary) {
-            // 二进制读取
-            file.seekg(0, std::ios::end);
-            std::streamsize size = file.tellg();
-            file.seekg(0, std::ios::beg);
-            
-            std::string buffer(size, '\0');
-            file.read(&buffer[0], size);
-            
-            return Value(buffer);
-        } else {
-            // 文本读取
-            std::stringstream buffer;
-            buffer << file.rdbuf();
-            return Value(buffer.str());
-        }
-    } catch (const std::exception& e) {
-        throw std::runtime_error("File read error: " + std::string(e.what()));
+void Executor::exitContext(const Value& context) {
+    if (context.type == Value::Type::FILE_OBJECT && context.fileObject()) {
+        context.fileObject()->close();
     }
 }
 
-// 添加文件写入支持
-Value Executor::evaluateFileWrite(const std::string& filename, const std::string& data, bool is_binary, const std::string& mode) {
-    try {
-        std::ios::openmode open_mode = std::ios::out;
-        if (mode.find('a') != std::string::npos) {
-            open_mode = std::ios::out | std::ios::app;
-        } else if (mode.find('w') != std::string::npos) {
-            open_mode = std::ios::out | std::ios::trunc;
-        }
-        
-        if (is_binary) {
-            open_mode |= std::ios::binary;
-        }
-        
-        std::ofstream file(filename, open_mode);
-        if (!file.is_open()) {
-            throw std::runtime_error("Could not open file for writing: " + filename);
-        }
-        
-        if (is_binary) {
-            file.write(data.data(), data.length());
-        } else {
-            file << data;
-        }
-        
-        file.close();
-        return Value((double)data.length()); // 返回写入的字符数
-    } catch (const std::exception& e) {
-        throw std::runtime_error("File write error: " + std::string(e.what()));
-    }
-}
-
-Value Executor::evaluateEval(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+Value Executor::evaluateEval(const Value* args, size_t argc) {
+    if (argc == 0) {
         throw std::runtime_error("eval() missing required argument");
     }
     
-    // 获取要评估的表达式字符串
-    Value expr_value = evaluateExpression(arguments[0].get());
-    std::string expr_str = expr_value.toString();
+    // 获取要评估的表达式字符串：参数本身是字符串时直接用它的文本，不复制
+    std::string converted;
+    const std::string& expr_str = args[0].type == Value::Type::STRING
+                                      ? args[0].stringValue()
+                                      : (converted = args[0].toString());
     
     // 如果表达式是纯数字，直接返回
     if (std::all_of(expr_str.begin(), expr_str.end(), [](char c) { 
         return std::isdigit(c) || c == '.'; 
     })) {
+        double number;
+        if (Utils::parseNumber(expr_str, number)) {
+            return Value(number);
+        }
+        // 否则继续下面的解析
+    }
+    
+    // 相同的表达式只解析一次，解析失败也会缓存下来
+    CodeCache::Entry* entry = evalCache.find(expr_str);
+    if (!entry) {
+        entry = &evalCache.insert(expr_str);
         try {
-            return Value(std::stod(expr_str));
-        } catch (...) {
-            // 继续下面的解析
+            // 只解析表达式（不是完整语句），AST归缓存条目所有
+            ExprNode* expr_node = entry->unit.parseExpression(entry->source);
+            Optimizer optimizer(entry->unit.arena);
+            entry->expr = optimizer.fold(expr_node);
+        } catch (const std::exception& e) {
+            entry->expr = nullptr;
         }
     }
     
+    if (!entry->expr) {
+        // 如果解析失败，尝试简单表达式解析
+        return parseAndEvaluateSimpleExpression(expr_str);
+    }
+    
+    CodeCache::Pin pin(*entry);
+    Profiler::Code scope(profiler, "<eval>");
     try {
-        // 创建新的词法分析器和解析器来处理表达式
-        Lexer lexer(expr_str);
-        auto tokens = lexer.tokenize();
-        
-        Parser parser(tokens);
-        // 只解析表达式（不是完整语句）
-        auto expr_node = parser.parseExpressionPublic();
-        
-        // 评估表达式
-        return evaluateExpression(expr_node.get());
+        prepareCached(*entry);
+        if (engine == Engine::VM) {
+            VM vm(*this);
+            return vm.run(*entry->code);
+        }
+        if (profiler) profiler->line(entry->expr->line);
+        return evaluateExpression(entry->expr);
     } catch (const std::exception& e) {
-        // 如果解析失败，尝试简单表达式解析
+        // 求值失败时同样回退到简单表达式解析
         return parseAndEvaluateSimpleExpression(expr_str);
     }
 }
 
-Value Executor::evaluateExec(const std::vector<std::unique_ptr<ExprNode>>& arguments) {
-    if (arguments.empty()) {
+void Executor::prepareCached(CodeCache::Entry& entry) {
+    bool needsCode = engine == Engine::VM && !entry.code;
+    if (entry.symbolCount != SIZE_MAX && !needsCode) {
+        return;
+    }
+    
+    // 槽位只增不减，已解析的名字不会变，每个条目只需要解析一次
+    if (entry.expr) {
+        CPPYTHON_STAT(eval_compiles, 1);
+        resolveNames(entry.expr);
+    } else {
+        CPPYTHON_STAT(exec_compiles, 1);
+        resolveNames(entry.unit.statements);
+    }
+    if (engine == Engine::VM) {
+        Compiler compiler;
+        entry.code = entry.expr ? compiler.compileEval(entry.expr)
+                                : compiler.compile(entry.unit.statements);
+    }
+    entry.symbolCount = symbols.size();
+}
+
+Value Executor::evaluateExec(const Value* args, size_t argc) {
+    if (argc == 0) {
         throw std::runtime_error("exec() missing required argument");
     }
     
-    // 获取要执行的代码字符串
-    Value code_value = evaluateExpression(arguments[0].get());
-    std::string code_str = code_value.toString();
+    // 获取要执行的代码字符串：已经是字符串且以换行符结尾时不复制
+    std::string converted;
+    const std::string* source = &converted;
+    if (args[0].type == Value::Type::STRING) {
+        source = &args[0].stringValue();
+    } else {
+        converted = args[0].toString();
+    }
     
     try {
         // 确保代码以换行符结尾
-        if (!code_str.empty() && code_str.back() != '\n') {
-            code_str += '\n';
+        if (!source->empty() && source->back() != '\n') {
+            if (source != &converted) converted = *source;
+            converted += '\n';
+            source = &converted;
         }
+        const std::string& code_str = *source;
         
-        // 创建新的词法分析器和解析器来处理代码
-        Lexer lexer(code_str);
-        auto tokens = lexer.tokenize();
-        
-        Parser parser(tokens);
-        auto statements = parser.parse();
+        // 相同的代码只解析和折叠一次，语法树归缓存条目所有
+        CodeCache::Entry* entry = execCache.find(code_str);
+        if (!entry) {
+            entry = &execCache.insert(code_str);
+            try {
+                entry->unit.parse(entry->source);
+            } catch (const std::exception&) {
+                // 语法错误不缓存，下次照常报错
+                execCache.erase(*entry);
+                throw;
+            }
+            Optimizer optimizer(entry->unit.arena);
+            optimizer.optimize(entry->unit.statements);
+        }
         
         // 执行语句（在当前执行器上下文中）
-        for (const auto& stmt : statements) {
-            executeStatement(stmt.get());
+        CodeCache::Pin pin(*entry);
+        Profiler::Code scope(profiler, "<exec>");
+        prepareCached(*entry);
+        if (engine == Engine::VM) {
+            VM vm(*this);
+            vm.run(*entry->code);
+        } else {
+            for (const auto& stmt : entry->unit.statements) {
+                executeStatement(stmt);
+            }
         }
         
         return Value(); // exec返回None
@@ -515,21 +836,29 @@ void Executor::executeWith(const WithStmt* withStmt) {
     // 简化实现：模拟with语句的行为
     try {
         // 评估上下文表达式
-        Value context_value = evaluateExpression(withStmt->context_expr.get());
+        Value context_value = evaluateExpression(withStmt->context_expr);
         
         // 如果有as子句，将上下文值赋给变量
         if (!withStmt->optional_vars.empty()) {
-            variables[withStmt->optional_vars] = std::move(context_value);
+            frame[withStmt->optional_slot] = context_value;
         }
         
-        // 执行with语句体
-        for (const auto& stmt : withStmt->body) {
-            executeStatement(stmt.get());
+        // 执行with语句体，不论是否出错，退出时都关闭上下文对象
+        try {
+            for (const auto& stmt : withStmt->body) {
+                executeStatement(stmt);
+            }
+        } catch (...) {
+            exitContext(context_value);
+            throw;
         }
+        // 关闭上下文对象算在with语句自己的行上（与字节码一致）
+        if (profiler) profiler->line(withStmt->line);
+        exitContext(context_value);
         
         // 清理：如果使用了as子句，从变量中移除
         if (!withStmt->optional_vars.empty()) {
-            variables.erase(withStmt->optional_vars);
+            frame[withStmt->optional_slot] = Value::unbound();
         }
         
     } catch (const std::exception& e) {
@@ -538,234 +867,247 @@ void Executor::executeWith(const WithStmt* withStmt) {
 }
 
 Value Executor::evaluateCall(const CallExpr* call) {
-    std::string funcName = dynamic_cast<IdentifierExpr*>(call->callee.get())->name;
-    
-    // 添加内置类型转换函数
-    if (funcName == "str") {
-        return evaluateStr(call->arguments);
-    }
-    
-    if (funcName == "repr") {
-        return evaluateRepr(call->arguments);
+    auto callee = nodeCast<IdentifierExpr>(call->callee);
+    if (!callee) {
+        throw std::runtime_error("Only named functions can be called");
     }
     
-    if (funcName == "int") {
-        return evaluateInt(call->arguments);
+    Arguments args(call->arguments.size());
+    for (const auto& arg : call->arguments) {
+        args.push(evaluateExpression(arg));
     }
     
-    if (funcName == "float") {
-        return evaluateFloat(call->arguments);
+    if (call->builtin != Builtin::NONE) {
+        return callBuiltin(call->builtin, args.data(), args.size());
     }
+    return callObject((uint32_t)callee->slot, args.data(), args.size());
+}
+
+Value Executor::evaluateMethodCall(const MethodCallExpr* call) {
+    // 参数不会改写变量时接收者按引用使用，不复制
+    Value scratch;
+    const Value& self = call->borrow ? evaluatePlace(call->object, scratch)
+                                     : (scratch = evaluateExpression(call->object));
     
-    if (funcName == "bool") {
-        return evaluateBool(call->arguments);
+    Arguments args(call->arguments.size());
+    for (const auto& arg : call->arguments) {
+        args.push(evaluateExpression(arg));
     }
     
-    if (funcName == "len") {
-        return evaluateLen(call->arguments);
+    return callMethod(self, call->method, call->cache, args.data(), args.size());
+}
+
+Value Executor::evaluateInput(const Value* args, size_t argc) {
+    if (argc > 0) {
+        output->writeValue(args[0]);
     }
-    
-    if (funcName == "input") {
-        // 内置input函数
-        if (!call->arguments.empty()) {
-            Value prompt = evaluateExpression(call->arguments[0].get());
-            fastPutString(prompt.toString());
-        }
-        std::string input = fastGetString();
-        return Value(input);
+    // readLine会先把提示和之前的输出刷新出去
+    return Value(readLine());
+}
+
+Value Executor::callBuiltin(Builtin id, const Value* args, size_t argc) {
+    Profiler::Call call(profiler, Builtins::name(id));
+    switch (id) {
+        case Builtin::STR: return evaluateStr(args, argc);
+        case Builtin::REPR: return evaluateRepr(args, argc);
+        case Builtin::INT: return evaluateInt(args, argc);
+        case Builtin::FLOAT: return evaluateFloat(args, argc);
+        case Builtin::BOOL: return evaluateBool(args, argc);
+        case Builtin::LEN: return evaluateLen(args, argc);
+        case Builtin::INPUT: return evaluateInput(args, argc);
+        case Builtin::PRINT:
+            // print函数调用，参数之间以空格分隔
+            printValues(args, argc, " ");
+            return Value(); // print返回None
+        case Builtin::OPEN: return evaluateOpen(args, argc);
+        case Builtin::EVAL: return evaluateEval(args, argc);
+        case Builtin::EXEC: return evaluateExec(args, argc);
+        case Builtin::STATS: return evaluateStats(args, argc);
+        case Builtin::SUM: return evaluateSum(args, argc);
+        case Builtin::MIN: return evaluateMinMax(args, argc, false);
+        case Builtin::MAX: return evaluateMinMax(args, argc, true);
+        case Builtin::NONE:
+        default:
+            return Value();
     }
-    
-    if (funcName == "print") {
-        // print函数调用
-        std::string output;
-        for (size_t i = 0; i < call->arguments.size(); i++) {
-            Value arg = evaluateExpression(call->arguments[i].get());
-            if (i > 0) output += " ";
-            output += arg.toString();
+}
+
+Value Executor::callObject(uint32_t slot, const Value* args, size_t argc) {
+    // 兼容旧写法 f("read")、f("write", data)：第一个参数是方法名
+    if (frame[slot].type == Value::Type::FILE_OBJECT) {
+        if (argc == 0) {
+            return Value();
         }
-        fastPutString(output + "\n");
-        return Value(); // print返回None
-    }
-    
-    if (funcName == "open") {
-        // open函数调用
-        return evaluateOpen(call->arguments);
-    }
-    
-    if (funcName == "eval") {
-        return evaluateEval(call->arguments);
+        // 方法名是运行时的值，不缓存
+        std::string methodName = args[0].toString();
+        MethodCache cache;
+        return callMethod(frame[slot], methodName, cache, args + 1, argc - 1);
     }
     
-    if (funcName == "exec") {
-        return evaluateExec(call->arguments);
+    throw std::runtime_error("Function " + symbols.name(slot) + " is not defined");
+}
+
+// 方法调用走调用点的内联缓存：接收者类型和上次相同时直接调用解析好的实现
+Value Executor::callMethod(const Value& self, std::string_view method, MethodCache& cache,
+                           const Value* args, size_t argc) {
+    Profiler::Call call(profiler, method, true);
+    if (cache.handler && cache.type == self.type) {
+        CPPYTHON_STAT(method_cache_hits, 1);
+        return cache.handler(self, args, argc);
     }
-    
-    // 检查是否是文件对象的方法调用
-    // 查找调用的对象（在call->callee中）
-    if (auto identifier = dynamic_cast<IdentifierExpr*>(call->callee.get())) {
-        auto it = variables.find(identifier->name);
-        if (it != variables.end() && it->second.type == Value::Type::FILE_OBJECT) {
-            Value& fileValue = const_cast<Value&>(it->second);
-            
-            // 对于方法调用，第一个参数通常是方法名
-            if (!call->arguments.empty()) {
-                // 获取方法名
-                std::string methodName = identifier->name; // 这里需要重新设计
-                
-                // 实际上，我们需要解析 obj.method() 这样的调用
-                // 但目前的AST不支持，所以我们简化处理
-                if (call->arguments.size() >= 1) {
-                    Value methodValue = evaluateExpression(call->arguments[0].get());
-                    std::string methodName = methodValue.toString();
-                    
-                    if (methodName == "read" && fileValue.file_object) {
-                        return evaluateFileRead(fileValue.file_object->filename, fileValue.file_object->is_binary);
-                    } else if (methodName == "write" && call->arguments.size() > 1 && fileValue.file_object) {
-                        Value dataValue = evaluateExpression(call->arguments[1].get());
-                        return evaluateFileWrite(fileValue.file_object->filename, dataValue.toString(), 
-                                               fileValue.file_object->is_binary, fileValue.file_object->mode);
-                    } else if (methodName == "close" && fileValue.file_object) {
-                        // 标记文件为关闭状态
-                        fileValue.file_object->is_open = false;
-                        return Value(); // 返回None
-                    }
-                }
-            }
-            return Value(); // 默认返回None
-        }
+    CPPYTHON_STAT(method_cache_misses, 1);
+    MethodHandler handler = Methods::resolve(self.type, Methods::lookup(method));
+    if (!handler) {
+        const char* owner = self.type == Value::Type::FILE_OBJECT ? "File object" : "Object";
+        throw std::runtime_error(std::string(owner) + " has no method '" + std::string(method) + "'");
     }
-    
-    throw std::runtime_error("Function " + funcName + " is not defined");
+    cache.type = self.type;
+    cache.handler = handler;
+    return handler(self, args, argc);
 }
 
 void Executor::executeStatement(const StmtNode* stmt) {
-    if (auto printStmt = dynamic_cast<const PrintStmt*>(stmt)) {
-        executePrint(printStmt);
-    } else if (auto assignStmt = dynamic_cast<const AssignStmt*>(stmt)) {
-        executeAssignment(assignStmt);
-    } else if (auto withStmt = dynamic_cast<const WithStmt*>(stmt)) {  // 添加with语句处理
-        executeWith(withStmt);
-    } else if (auto exprStmt = dynamic_cast<const ExprStmt*>(stmt)) {
-        // 只在交互模式下输出表达式结果
-        Value result = evaluateExpression(exprStmt->expression.get());
-        if (interactiveMode && result.type != Value::Type::NONE) {
-            fastPutString(result.toString() + "\n");
+    if (profiler) profiler->line(stmt->line);
+    CPPYTHON_STAT(ast_dispatches, 1);
+    switch (stmt->kind) {
+        case NodeKind::PRINT:
+            executePrint(static_cast<const PrintStmt*>(stmt));
+            break;
+        case NodeKind::ASSIGN:
+            executeAssignment(static_cast<const AssignStmt*>(stmt));
+            break;
+        case NodeKind::WITH:  // 添加with语句处理
+            executeWith(static_cast<const WithStmt*>(stmt));
+            break;
+        case NodeKind::EXPR_STMT: {
+            // 只在交互模式下输出表达式结果
+            Value result = evaluateExpression(static_cast<const ExprStmt*>(stmt)->expression);
+            if (interactiveMode && result.type != Value::Type::NONE) {
+                output->writeValue(result);
+                output->endLine();
+            }
+            break;
         }
+        default:
+            break;
     }
 }
 
 void Executor::executePrint(const PrintStmt* printStmt) {
     // 无空格分隔连接所有参数
-    std::string output;
-    for (size_t i = 0; i < printStmt->expressions.size(); i++) {
-        Value value = evaluateExpression(printStmt->expressions[i].get());
-        output += value.toString();
+    Arguments values(printStmt->expressions.size());
+    for (const auto& expr : printStmt->expressions) {
+        values.push(evaluateExpression(expr));
+    }
+    Profiler::Call call(profiler, "print");
+    printValues(values.data(), values.size(), "");
+}
+
+void Executor::printValues(const Value* values, size_t count, const char* separator) {
+    // 直接格式化进输出缓冲区
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) output->write(separator);
+        output->writeValue(values[i]);
     }
-    output += "\n";
-    fastPutString(output);
+    output->endLine();
 }
 
 void Executor::executeAssignment(const AssignStmt* assignStmt) {
-    Value value = evaluateExpression(assignStmt->value.get());
-    variables[assignStmt->variable] = std::move(value);
+    if (assignStmt->append && frame[assignStmt->slot].type == Value::Type::STRING) {
+        // s = s + x：不把s复制出来，直接在变量上追加
+        auto binary = static_cast<const BinaryExpr*>(assignStmt->value);
+        Value piece = evaluateExpression(binary->right);
+        frame[assignStmt->slot].appendText(piece);
+        return;
+    }
+    Value value = evaluateExpression(assignStmt->value);
+    frame[assignStmt->slot] = std::move(value);
+}
+
+void Executor::resolveNames(const StmtList& statements) {
+    Resolver resolver(symbols, &literals);
+    resolver.resolve(statements);
+    frame.resize(symbols.size(), Value::unbound());
+}
+
+void Executor::resolveNames(ExprNode* expr) {
+    Resolver resolver(symbols, &literals);
+    resolver.resolve(expr);
+    frame.resize(symbols.size(), Value::unbound());
+}
+
+const Value& Executor::slotValue(int slot) const {
+    const Value& value = frame[slot];
+    return value.isBound() ? value : kNone;
 }
 
-void Executor::execute(const std::vector<std::unique_ptr<StmtNode>>& statements) {
+Value* Executor::findVariable(std::string_view name) {
+    CPPYTHON_STAT(name_lookups, 1);
+    int slot = symbols.find(name);
+    if (slot < 0 || !frame[slot].isBound()) {
+        return nullptr;
+    }
+    return &frame[slot];
+}
+
+void Executor::execute(CompilationUnit& unit) {
+    if (engine == Engine::VM) {
+        auto code = compile(unit);
+        run(*code);
+        return;
+    }
+    
+    const StmtList& statements = unit.statements;
+    Optimizer optimizer(unit.arena);
+    optimizer.optimize(statements);
+    resolveNames(statements);
     for (const auto& stmt : statements) {
-        executeStatement(stmt.get());
+        executeStatement(stmt);
     }
 }
 
-std::string Executor::fastGetString() {
-    std::string result;
-    std::getline(std::cin, result);
-    return result;
+std::unique_ptr<CodeObject> Executor::compile(CompilationUnit& unit) {
+    Optimizer optimizer(unit.arena);
+    optimizer.optimize(unit.statements);
+    resolveNames(unit.statements);
+    Compiler compiler;
+    return compiler.compile(unit.statements);
 }
 
-void Executor::fastPutString(const std::string& str) {
-    std::cout << str;
-    std::cout.flush();
+void Executor::run(const CodeObject& code) {
+    // 缓存加载的代码可能登记了新的名字
+    frame.resize(symbols.size(), Value::unbound());
+    VM vm(*this);
+    vm.run(code);
 }
 
-// 快速IO优化
-void Executor::fastIO() {
-    std::ios_base::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-    std::cout.tie(nullptr);
+bool Executor::getVariable(std::string_view name, Value& value) {
+    Value* variable = findVariable(name);
+    if (!variable) return false;
+    value = *variable;
+    return true;
 }
 
-std::string Value::toString() const {
-    switch (type) {
-        case Type::NUMBER:
-            {
-                std::ostringstream oss;
-                if (number == static_cast<long long>(number)) {
-                    oss << static_cast<long long>(number);
-                } else {
-                    oss << number;
-                }
-                return oss.str();
-            }
-        case Type::STRING:
-            return string_value;
-        case Type::BOOLEAN:
-            return boolean ? "True" : "False";
-        case Type::LIST:
-            {
-                std::string result = "[";
-                for (size_t i = 0; i < list_value.size(); i++) {
-                    if (i > 0) result += ", ";
-                    result += list_value[i].toString();
-                }
-                result += "]";
-                return result;
-            }
-        case Type::FILE_OBJECT:
-            if (file_object) {
-                return "<file '" + file_object->filename + "' mode '" + file_object->mode + "'>";
-            } else {
-                return "<closed file>";
-            }
-        case Type::NONE:
-        default:
-            return "None";
+void Executor::setVariable(std::string_view name, Value value) {
+    uint32_t slot = symbols.intern(name);
+    frame.resize(symbols.size(), Value::unbound());
+    frame[slot] = std::move(value);
+}
+
+void Executor::reset() {
+    for (auto& value : frame) {
+        value = Value::unbound();
     }
 }
 
-double Value::toNumber() const {
-    switch (type) {
-        case Type::NUMBER:
-            return number;
-        case Type::STRING:
-            try {
-                return std::stod(string_value);
-            } catch (...) {
-                return 0.0;
-            }
-        case Type::BOOLEAN:
-            return boolean ? 1.0 : 0.0;
-        case Type::LIST:
-            return (double)list_value.size();
-        case Type::NONE:
-        default:
-            return 0.0;
-    }
-}
-
-bool Value::toBoolean() const {
-    switch (type) {
-        case Type::NUMBER:
-            return number != 0.0;
-        case Type::STRING:
-            return !string_value.empty();
-        case Type::BOOLEAN:
-            return boolean;
-        case Type::LIST:
-            return !list_value.empty();
-        case Type::FILE_OBJECT:
-            return file_object && file_object->is_open;
-        case Type::NONE:
-        default:
-            return false;
+std::string Executor::readLine() {
+    std::string result;
+    // 读取输入前先把缓冲的输出（包括提示）写出去
+    output->flush();
+    if (input) {
+        // 标准输入只在第一次真正读它时解除同步，不读输入的脚本省掉这部分启动开销
+        if (input == &std::cin) Utils::enableFastIO();
+        std::getline(*input, result);
     }
-}
\ No newline at end of file
+    return result;
+}
@@ -2,179 +2,112 @@
 #define EXECUTOR_H
 
 #include "parser.h"
+#include "value.h"
+#include "builtins.h"
+#include "resolver.h"
+#include "codecache.h"
+#include "stringpool.h"
 #include <unordered_map>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <fstream>
 #include <memory>
 #include <sstream>
 
-// 值类型
-class Value {
-public:
-    enum class Type {
-        NUMBER,
-        STRING,
-        BOOLEAN,
-        NONE,
-        FILE_OBJECT,
-        LIST  // 添加列表类型
-    };
-    
-    Type type;
-    union {
-        double number;
-        bool boolean;
-    };
-    std::string string_value;
-    
-    // 添加列表支持
-    std::vector<Value> list_value;
-    
-    // 文件对象支持
-    struct FileObject {
-        std::string filename;
-        std::string mode;
-        bool is_binary;
-        bool is_open;
-        
-        FileObject(const std::string& fname, const std::string& m, bool binary)
-            : filename(fname), mode(m), is_binary(binary), is_open(true) {
-        }
-    };
-    
-    std::unique_ptr<FileObject> file_object;
-    
-    // 默认构造函数
-    Value() : type(Type::NONE) {}
-    
-    // 数字构造函数
-    Value(double n) : type(Type::NUMBER), number(n) {}
-    
-    // 字符串构造函数
-    Value(const std::string& s) : type(Type::STRING), string_value(s) {}
-    
-    // 布尔构造函数
-    Value(bool b) : type(Type::BOOLEAN), boolean(b) {}
-    
-    // 列表构造函数
-    Value(const std::vector<Value>& list) : type(Type::LIST), list_value(list) {}
-    
-    // 文件对象构造函数
-    Value(std::unique_ptr<FileObject> file_obj) : type(Type::FILE_OBJECT), file_object(std::move(file_obj)) {}
-    
-    // 拷贝构造函数
-    Value(const Value& other) : type(other.type) {
-        switch (type) {
-            case Type::NUMBER:
-                number = other.number;
-                break;
-            case Type::STRING:
-                string_value = other.string_value;
-                break;
-            case Type::BOOLEAN:
-                boolean = other.boolean;
-                break;
-            case Type::LIST:
-                list_value = other.list_value;
-                break;
-            case Type::FILE_OBJECT:
-                // 文件对象拷贝：只拷贝元数据
-                if (other.file_object) {
-                    file_object = std::make_unique<FileObject>(
-                        other.file_object->filename,
-                        other.file_object->mode,
-                        other.file_object->is_binary
-                    );
-                    file_object->is_open = other.file_object->is_open;
-                }
-                break;
-            case Type::NONE:
-            default:
-                break;
-        }
-    }
-    
-    // 拷贝赋值操作符
-    Value& operator=(const Value& other) {
-        if (this != &other) {
-            type = other.type;
-            switch (type) {
-                case Type::NUMBER:
-                    number = other.number;
-                    break;
-                case Type::STRING:
-                    string_value = other.string_value;
-                    break;
-                case Type::BOOLEAN:
-                    boolean = other.boolean;
-                    break;
-                case Type::LIST:
-                    list_value = other.list_value;
-                    break;
-                case Type::FILE_OBJECT:
-                    // 文件对象拷贝：只拷贝元数据
-                    if (other.file_object) {
-                        file_object = std::make_unique<FileObject>(
-                            other.file_object->filename,
-                            other.file_object->mode,
-                            other.file_object->is_binary
-                        );
-                        file_object->is_open = other.file_object->is_open;
-                    }
-                    break;
-                case Type::NONE:
-                default:
-                    break;
-            }
-        }
-        return *this;
-    }
-    
-    std::string toString() const;
-    double toNumber() const;
-    bool toBoolean() const;
+struct CodeObject;
+class Profiler;
+class OutputBuffer;
+
+// 执行引擎
+enum class Engine {
+    VM,   // 字节码虚拟机（默认）
+    AST   // 树遍历执行器，作为参考实现和回退
 };
 
 class Executor {
 private:
-    std::unordered_map<std::string, Value> variables;
+    friend class VM;
+    
+    // 变量环境：按槽位编号存放的连续数组，名字只在解析和按名查找时使用
+    // 分配了槽位但还没有赋值的变量是Value::unbound()
+    SymbolTable symbols;
+    std::vector<Value> frame;
+    // 字符串字面量的驻留池：AST求值和字节码常量共享同一份负载
+    StringPool literals;
     bool interactiveMode;
+    Engine engine;
+    Profiler* profiler;  // --profile时由解释器设置，否则为nullptr
+    // 本实例的输入输出：默认是进程的标准输出缓冲区和std::cin，嵌入时各实例单独设置
+    OutputBuffer* output;
+    std::istream* input;  // nullptr时input()读到空行
+    
+    // eval()/exec()按源码文本缓存编译结果
+    CodeCache evalCache;
+    CodeCache execCache;
+    
+    // 虚拟机的值栈按eval/exec的嵌套深度复用，不在每次执行时重新分配
+    std::vector<std::vector<Value>> vmStacks;
+    size_t vmDepth = 0;
+    
+    // 给新解析的代码分配槽位并扩展变量数组
+    void resolveNames(const StmtList& statements);
+    void resolveNames(ExprNode* expr);
+    // 缓存条目在符号表变化后重新解析槽位，虚拟机引擎下按需重新编译
+    void prepareCached(CodeCache::Entry& entry);
+    // 按槽位读变量，未赋值时得到None
+    const Value& slotValue(int slot) const;
+    // 按名字查找变量（eval/exec/f-string使用），不存在或未赋值时返回nullptr
+    Value* findVariable(std::string_view name);
     
     Value evaluateExpression(const ExprNode* expr);
     Value evaluateLiteral(const LiteralExpr* literal);
     Value evaluateList(const ListExpr* list);
     Value evaluateIndex(const IndexExpr* index);
+    const Value& evaluatePlace(const ExprNode* expr, Value& scratch);
+    Value evaluateSlice(const SliceExpr* slice);
     Value evaluateFString(const FStringExpr* fstring);
     Value evaluateIdentifier(const IdentifierExpr* identifier);
     Value evaluateBinary(const BinaryExpr* binary);
     Value evaluateCall(const CallExpr* call);
+    Value evaluateMethodCall(const MethodCallExpr* call);
+    
+    // 内置函数和对象调用（AST执行器和虚拟机共用，参数已求值）
+    Value callBuiltin(Builtin id, const Value* args, size_t argc);
+    Value callObject(uint32_t slot, const Value* args, size_t argc);
+    Value callMethod(const Value& self, std::string_view method, MethodCache& cache,
+                     const Value* args, size_t argc);
     
     // 新增：eval和exec功能
-    Value evaluateEval(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    Value evaluateExec(const std::vector<std::unique_ptr<ExprNode>>& arguments);
+    Value evaluateEval(const Value* args, size_t argc);
+    Value evaluateExec(const Value* args, size_t argc);
     
     // 新增：with语句功能
     void executeWith(const WithStmt* withStmt);
     
     // 新增：文件操作功能
-    Value evaluateOpen(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    Value evaluateFileRead(const std::string& filename, bool is_binary);
-    Value evaluateFileWrite(const std::string& filename, const std::string& data, bool is_binary, const std::string& mode);
+    Value evaluateOpen(const Value* args, size_t argc);
     
     // 新增：内置函数
-    Value evaluateStr(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    Value evaluateRepr(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    Value evaluateInt(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    Value evaluateFloat(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    Value evaluateBool(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    Value evaluateLen(const std::vector<std::unique_ptr<ExprNode>>& arguments);
-    
-    // f-string表达式解析辅助函数
+    Value evaluateStr(const Value* args, size_t argc);
+    Value evaluateRepr(const Value* args, size_t argc);
+    Value evaluateInt(const Value* args, size_t argc);
+    Value evaluateFloat(const Value* args, size_t argc);
+    Value evaluateBool(const Value* args, size_t argc);
+    Value evaluateLen(const Value* args, size_t argc);
+    Value evaluateSum(const Value* args, size_t argc);
+    Value evaluateMinMax(const Value* args, size_t argc, bool maximum);
+    Value evaluateInput(const Value* args, size_t argc);
+    Value evaluateStats(const Value* args, size_t argc);
+    
+    // f-string渲染和表达式解析辅助函数
     Value parseAndEvaluateSimpleExpression(const std::string& expr_str);
     
+    // 输出多个值，separator为值之间的分隔符
+    void printValues(const Value* values, size_t count, const char* separator);
+    
     void executeStatement(const StmtNode* stmt);
     void executePrint(const PrintStmt* printStmt);
     void executeAssignment(const AssignStmt* assignStmt);
@@ -182,12 +115,58 @@ private:
 public:
     Executor(bool isInteractive = false);
     void setInteractiveMode(bool interactive) { interactiveMode = interactive; }
-    void execute(const std::vector<std::unique_ptr<StmtNode>>& statements);
-    
-    // 快速输入输出
-    static std::string fastGetString();
-    static void fastPutString(const std::string& str);
-    static void fastIO();
+    void setEngine(Engine e) { engine = e; }
+    Engine getEngine() const { return engine; }
+    void setProfiler(Profiler* p) { profiler = p; }
+    void setOutput(OutputBuffer* out) { output = out; }
+    void setInput(std::istream* in) { input = in; }
+    OutputBuffer& getOutput() { return *output; }
+    // 执行一个编译单元：常量折叠、分配槽位，然后交给所选的执行引擎
+    void execute(CompilationUnit& unit);
+    // 只做常量折叠、分配槽位和编译，结果不引用语法树
+    std::unique_ptr<CodeObject> compile(CompilationUnit& unit);
+    // 在虚拟机上执行已编译的代码
+    void run(const CodeObject& code);
+    SymbolTable& symbolTable() { return symbols; }
+    
+    // 按名字读写变量（嵌入使用）；set会在需要时分配新槽位
+    bool getVariable(std::string_view name, Value& value);
+    void setVariable(std::string_view name, Value value);
+    // 清空所有变量的值，保留槽位分配和编译缓存，已编译的代码可以直接再次执行
+    void reset();
+    
+    // 运行时计数器加上eval/exec缓存的命中情况（--stats和stats()使用）
+    // 没有编译计数器时只有缓存部分
+    std::vector<std::pair<const char*, uint64_t>> statistics() const;
+    
+    // 二元运算语义（AST执行器和虚拟机共用）
+    static Value applyBinary(TokenType op, const Value& left, const Value& right);
+    // 两边都是数字时的快速路径：不做类型转换，比较直接得到布尔值
+    static Value applyNumbers(TokenType op, double left, double right) {
+        CPPYTHON_STAT(binary_fast, 1);
+        switch (op) {
+            case TokenType::PLUS: return Value(left + right);
+            case TokenType::MINUS: return Value(left - right);
+            case TokenType::MULTIPLY: return Value(left * right);
+            case TokenType::DIVIDE: return Value(left / right);
+            case TokenType::MODULO: return Value(std::fmod(left, right));
+            case TokenType::EQUAL: return Value(left == right);
+            case TokenType::NOT_EQUAL: return Value(left != right);
+            case TokenType::LESS: return Value(left < right);
+            case TokenType::GREATER: return Value(left > right);
+            default: return Value();
+        }
+    }
+    static Value applyIndex(const Value& container, const Value& index);
+    static Value applySlice(const Value& container, const Value& start, const Value& stop);
+    // 离开with语句：文件对象在这里关闭
+    static void exitContext(const Value& context);
+    // 拼接f-string的各个片段
+    static Value buildString(const Value* parts, size_t count);
+    static void appendFStringValue(std::string& out, const Value& value);
+    
+    // 从本实例的输入读一行（input()使用）
+    std::string readLine();
 };
 
 #endif
\ No newline at end of file
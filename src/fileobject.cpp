@@ -0,0 +1,444 @@
+#include "value.h"
+#include "utils.h"
+#include "asyncio.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr size_t kFileBufferSize = 64 * 1024;
+
+    // 把Python的打开模式转换成open()的标志；文本和二进制的区别由文件对象自己处理
+    int openFlags(const std::string& mode) {
+        bool plus = mode.find('+') != std::string::npos;
+        int flags;
+        if (mode.find('w') != std::string::npos) {
+            flags = O_CREAT | O_TRUNC;
+        } else if (mode.find('a') != std::string::npos) {
+            flags = O_CREAT | O_APPEND;
+        } else if (mode.find('x') != std::string::npos) {
+            flags = O_CREAT | O_EXCL;
+        } else {
+            return plus ? O_RDWR : O_RDONLY;
+        }
+        return flags | (plus ? O_RDWR : O_WRONLY);
+    }
+
+    int openFile(const std::string& filename, int flags) {
+#ifdef _WIN32
+        return _open(filename.c_str(), flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        return ::open(filename.c_str(), flags | O_CLOEXEC, 0666);
+#endif
+    }
+
+    void closeFile(int fd) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+
+    // 文件大小；不是普通文件时regular为false
+    uint64_t fileSize(int fd, bool& regular) {
+#ifdef _WIN32
+        struct _stat64 info;
+        regular = _fstat64(fd, &info) == 0 && (info.st_mode & _S_IFREG);
+#else
+        struct stat info;
+        regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+#endif
+        return regular ? (uint64_t)info.st_size : 0;
+    }
+
+    // 管道等不能按位置读写的文件直接同步读写
+    long long readStream(int fd, char* buffer, size_t length) {
+#ifdef _WIN32
+        return _read(fd, buffer, (unsigned)std::min<size_t>(length, 0x7fffffff));
+#else
+        while (true) {
+            ssize_t n = ::read(fd, buffer, length);
+            if (n >= 0 || errno != EINTR) return n;
+        }
+#endif
+    }
+
+    bool writeStream(int fd, const char* data, size_t length) {
+        while (length > 0) {
+#ifdef _WIN32
+            long long n = _write(fd, data, (unsigned)std::min<size_t>(length, 0x7fffffff));
+#else
+            ssize_t n = ::write(fd, data, length);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            if (n <= 0) return false;
+            data += n;
+            length -= (size_t)n;
+        }
+        return true;
+    }
+
+    // 按位置写完length个字节：n是第一次请求的结果，短写（例如磁盘快满时）时接着写剩下的
+    bool completeWrite(int fd, const char* data, size_t length, uint64_t offset, long long n) {
+        size_t done = 0;
+        while (n > 0 && (done += (size_t)n) < length) {
+            n = AsyncIO::wait(AsyncIO::write(fd, data + done, length - done, offset + done));
+        }
+        return done == length;
+    }
+
+#ifdef _WIN32
+    // Windows文本模式和C运行库一样转换换行：读入时\r\n变成\n，写出时\n变成\r\n
+    // 读到的n个字节在buffer[1..n]，结果从buffer[0]开始写（不会超过读的位置），返回结果长度；
+    // 块末尾的\r先不输出，看下一块是不是以\n开头
+    size_t translateInput(char* buffer, size_t n, bool& carriage, bool atEnd) {
+        const char* in = buffer + 1;
+        char* out = buffer;
+        if (carriage && (n == 0 || in[0] != '\n')) *out++ = '\r';
+        carriage = false;
+        for (size_t i = 0; i < n; i++) {
+            if (in[i] == '\r') {
+                if (i + 1 == n && !atEnd) {
+                    carriage = true;
+                    break;
+                }
+                if (i + 1 < n && in[i + 1] == '\n') continue;
+            }
+            *out++ = in[i];
+        }
+        return (size_t)(out - buffer);
+    }
+#endif
+}
+
+Value::FileObject::FileObject(const std::string& fname, const std::string& m, bool binary)
+    : filename(fname), mode(m), is_binary(binary), is_open(false),
+      readable(false), writable(false), fd(-1), seekable(false), writing(false), eof(false),
+      carriage(false), drained(false), cursor(0), limit(0), nextRead(0), aheadTicket(0), writeOffset(0),
+      flightOffset(0), flightTicket(0) {
+    bool plus = m.find('+') != std::string::npos;
+    bool write_mode = m.find_first_of("wax") != std::string::npos;
+    readable = plus || !write_mode;
+    writable = plus || write_mode;
+}
+
+Value::FileObject::~FileObject() {
+    // 析构时不能抛出：后台写入的错误只能在显式close()时报告
+    try {
+        close();
+    } catch (const std::exception&) {
+    }
+}
+
+bool Value::FileObject::open() {
+    fd = openFile(filename, openFlags(mode));
+    if (fd < 0) return false;
+
+    uint64_t size = fileSize(fd, seekable);
+    // 追加模式从末尾开始，读和写都一样
+    uint64_t start = mode.find('a') != std::string::npos ? size : 0;
+    nextRead = start;
+    writeOffset = start;
+    writing = !readable;
+    is_open = true;
+
+    // 只读打开已有内容时马上排队读第一块：连续打开多个文件时这些预读
+    // 在第一次等待时一起提交
+    if (readable && seekable && mode.find_first_of("wax") == std::string::npos) {
+        startReadAhead();
+    }
+    return true;
+}
+
+void Value::FileObject::checkOpen() const {
+    if (!is_open) {
+        throw std::runtime_error("I/O operation on closed file: " + filename);
+    }
+}
+
+// 缓冲区多留一个字节：读到的内容放在[1, n]，Windows文本模式的\r可以补在前面
+void Value::FileObject::startReadAhead() {
+    if (!ahead) ahead.reset(new char[kFileBufferSize + 1]);
+    aheadTicket = AsyncIO::read(fd, ahead.get() + 1, kFileBufferSize, nextRead);
+}
+
+void Value::FileObject::keepReading() {
+    if (!seekable || eof || drained || aheadTicket || limit - cursor > kFileBufferSize / 2) return;
+    startReadAhead();
+    AsyncIO::submit();
+}
+
+bool Value::FileObject::fill() {
+    if (cursor < limit) return true;
+    cursor = limit = 0;
+    // 文本转换可能把一块变成空的（只有一个\r），这时接着读
+    while (cursor == limit && !eof) {
+        long long n;
+        if (seekable) {
+            if (!aheadTicket) startReadAhead();
+            n = AsyncIO::wait(aheadTicket);
+            aheadTicket = 0;
+            if (n < 0) throw std::runtime_error("Error reading file: " + filename);
+            data.swap(ahead);
+            nextRead += (uint64_t)n;
+        } else {
+            if (!data) data.reset(new char[kFileBufferSize + 1]);
+            n = readStream(fd, data.get() + 1, kFileBufferSize);
+            if (n < 0) throw std::runtime_error("Error reading file: " + filename);
+        }
+        cursor = 1;
+        limit = 1 + (size_t)n;
+        eof = n == 0;
+        drained = (size_t)n < kFileBufferSize;
+#ifdef _WIN32
+        if (!is_binary) {
+            cursor = 0;
+            limit = translateInput(data.get(), (size_t)n, carriage, eof);
+        }
+#endif
+    }
+    return cursor < limit;
+}
+
+void Value::FileObject::discardReads() {
+    if (aheadTicket) {
+        AsyncIO::wait(aheadTicket);
+        aheadTicket = 0;
+    }
+    cursor = limit = 0;
+}
+
+void Value::FileObject::toReading() {
+    if (!writing) return;
+    startWrite();
+    finishWrite();
+    nextRead = writeOffset;
+    eof = false;
+    drained = false;
+    writing = false;
+}
+
+void Value::FileObject::toWriting() {
+    if (writing) return;
+    // 从读到的位置接着写（Windows文本模式下缓冲区里的内容经过转换，位置是近似的）
+    writeOffset = readPosition();
+    discardReads();
+    writing = true;
+}
+
+std::string Value::FileObject::read(long long size) {
+    checkOpen();
+    if (!readable) throw std::runtime_error("File not open for reading: " + filename);
+    toReading();
+
+    std::string result;
+    if (size >= 0) {
+        while (result.size() < (size_t)size && fill()) {
+            size_t take = std::min((size_t)size - result.size(), limit - cursor);
+            result.append(data.get() + cursor, take);
+            cursor += take;
+        }
+        keepReading();
+        CPPYTHON_STAT(file_bytes_read, result.size());
+        return result;
+    }
+
+    // 读到末尾：先取走缓冲区里的内容和已经在读的下一块
+    if (cursor < limit) {
+        result.append(data.get() + cursor, limit - cursor);
+        cursor = limit;
+    }
+    bool regular;
+    uint64_t total = fileSize(fd, regular);
+#ifdef _WIN32
+    bool direct = regular && is_binary;
+#else
+    bool direct = regular;
+#endif
+    if (direct && !eof && total > nextRead) {
+        if (aheadTicket) {
+            long long n = AsyncIO::wait(aheadTicket);
+            aheadTicket = 0;
+            if (n < 0) throw std::runtime_error("Error reading file: " + filename);
+            result.append(ahead.get() + 1, (size_t)n);
+            nextRead += (uint64_t)n;
+        }
+        // 剩下的部分一次读进结果，不经过缓冲区
+        if (total > nextRead) {
+            size_t have = result.size();
+            result.resize(have + (size_t)(total - nextRead));
+            long long n = AsyncIO::wait(AsyncIO::read(fd, &result[have], result.size() - have, nextRead));
+            if (n < 0) throw std::runtime_error("Error reading file: " + filename);
+            result.resize(have + (size_t)n);
+            nextRead += (uint64_t)n;
+        }
+    }
+    // 管道、文本转换，或者文件在读的过程中变长了
+    while (fill()) {
+        result.append(data.get() + cursor, limit - cursor);
+        cursor = limit;
+    }
+    CPPYTHON_STAT(file_bytes_read, result.size());
+    return result;
+}
+
+// 二进制文件读到末尾时不复制：把文件映射进来，返回指向剩余部分的字节串，
+// 页面在真正访问时才由操作系统按需载入。无法映射时退化为普通读取
+Value Value::FileObject::readMapped() {
+    checkOpen();
+    if (!readable) throw std::runtime_error("File not open for reading: " + filename);
+    toReading();
+
+    if (seekable) {
+        uint64_t start = readPosition();
+        auto mapping = std::make_shared<Utils::MappedFile>();
+        if (mapping->open(filename) && start <= mapping->size()) {
+            // 和read()读完一样，把读取位置移到末尾
+            discardReads();
+            nextRead = mapping->size();
+            eof = true;
+            std::string_view rest = mapping->view().substr((size_t)start);
+            CPPYTHON_STAT(file_bytes_read, rest.size());
+            return Value::bytes(std::move(mapping), rest.data(), rest.size());
+        }
+    }
+    return Value::bytes(read(-1));
+}
+
+std::string Value::FileObject::readline() {
+    checkOpen();
+    if (!readable) throw std::runtime_error("File not open for reading: " + filename);
+    toReading();
+
+    std::string line;
+    while (fill()) {
+        const char* begin = data.get() + cursor;
+        size_t available = limit - cursor;
+        const void* newline = std::memchr(begin, '\n', available);
+        size_t take = newline ? (size_t)(static_cast<const char*>(newline) - begin) + 1 : available;
+        line.append(begin, take);
+        cursor += take;
+        if (newline) break;
+    }
+    keepReading();
+    CPPYTHON_STAT(file_bytes_read, line.size());
+    return line;
+}
+
+Value::List Value::FileObject::readlines() {
+    List lines;
+    while (true) {
+        std::string line = readline();
+        if (line.empty()) break;
+        lines.emplace_back(std::move(line));
+    }
+    return lines;
+}
+
+size_t Value::FileObject::write(std::string_view text) {
+    checkOpen();
+    if (!writable) throw std::runtime_error("File not open for writing: " + filename);
+    toWriting();
+
+    // 写入文件对象自己的缓冲区，满一块后在后台落盘
+#ifdef _WIN32
+    if (!is_binary) {
+        for (char c : text) {
+            if (c == '\n') pending += '\r';
+            pending += c;
+        }
+    } else {
+        pending.append(text);
+    }
+#else
+    if (seekable && text.size() >= kFileBufferSize) {
+        // 大块数据复制一遍的代价和写本身差不多：先交出已缓冲的部分，
+        // 再直接从调用者的数据写，等它完成
+        startWrite();
+        finishWrite();
+        uint64_t offset = writeOffset;
+        writeOffset += text.size();
+        long long n = AsyncIO::wait(AsyncIO::write(fd, text.data(), text.size(), offset));
+        if (!completeWrite(fd, text.data(), text.size(), offset, n)) {
+            throw std::runtime_error("Error writing file: " + filename);
+        }
+        CPPYTHON_STAT(file_bytes_written, text.size());
+        return text.size();
+    }
+    pending.append(text);
+#endif
+    if (pending.size() >= kFileBufferSize) startWrite();
+    CPPYTHON_STAT(file_bytes_written, text.size());
+    return text.size();
+}
+
+void Value::FileObject::startWrite() {
+    if (pending.empty()) return;
+    if (!seekable) {
+        bool ok = writeStream(fd, pending.data(), pending.size());
+        pending.clear();
+        if (!ok) throw std::runtime_error("Error writing file: " + filename);
+        return;
+    }
+    // 上一块写完之前不能动它的缓冲区
+    finishWrite();
+    flight.swap(pending);
+    pending.clear();
+    flightOffset = writeOffset;
+    writeOffset += flight.size();
+    flightTicket = AsyncIO::write(fd, flight.data(), flight.size(), flightOffset);
+    AsyncIO::submit();
+}
+
+void Value::FileObject::finishWrite() {
+    if (!flightTicket) return;
+    long long n = AsyncIO::wait(flightTicket);
+    flightTicket = 0;
+    bool complete = completeWrite(fd, flight.data(), flight.size(), flightOffset, n);
+    flight.clear();
+    if (!complete) throw std::runtime_error("Error writing file: " + filename);
+}
+
+void Value::FileObject::flush() {
+    checkOpen();
+    if (writing) {
+        startWrite();
+        finishWrite();
+    }
+}
+
+void Value::FileObject::close() {
+    if (fd < 0) {
+        is_open = false;
+        return;
+    }
+    // 写入出错时也要关闭文件，再把错误报告出去
+    try {
+        if (writing) {
+            startWrite();
+            finishWrite();
+        }
+    } catch (const std::exception&) {
+        discardReads();
+        closeFile(fd);
+        fd = -1;
+        is_open = false;
+        throw;
+    }
+    discardReads();
+    closeFile(fd);
+    fd = -1;
+    is_open = false;
+}
@@ -3,131 +3,406 @@
 #include "parser.h"
 #include "executor.h"
 #include "utils.h"
+#include "output.h"
+#include "bytecache.h"
+#include "compiler.h"
+#include "profiler.h"
+#include "stats.h"
+#include "perfect_hash.h"
+#include "embed.h"
+#include "workerpool.h"
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 
-PythonInterpreter::PythonInterpreter() {
+PythonInterpreter::PythonInterpreter() : writeBytecode(true), profiling(false), showStats(false) {
     executor = std::make_unique<Executor>(false);  // 文件执行模式
 }
 
 PythonInterpreter::~PythonInterpreter() = default;
 
+void PythonInterpreter::setEngine(Engine engine) {
+    executor->setEngine(engine);
+}
+
+void PythonInterpreter::enableProfiling(const std::string& collapsedOutput) {
+    profiling = true;
+    collapsedFile = collapsedOutput;
+}
+
 bool PythonInterpreter::executeFile(const std::string& filename) {
+    return execute(Source::SCRIPT, filename);
+}
+
+bool PythonInterpreter::executeCommand(const std::string& command) {
+    return execute(Source::COMMAND, command);
+}
+
+bool PythonInterpreter::executeStdin() {
+    return execute(Source::STANDARD_INPUT, std::string());
+}
+
+bool PythonInterpreter::execute(Source kind, const std::string& source) {
+    if (!profiling) {
+        bool ok = runSource(kind, source);
+        reportStats();
+        return ok;
+    }
+    
+    Profiler profiler(kind == Source::SCRIPT ? source : kind == Source::COMMAND ? "<string>" : "<stdin>");
+    executor->setProfiler(&profiler);
+    bool ok = runSource(kind, source);
+    executor->setProfiler(nullptr);
+    profiler.finish();
+    reportStats();
+    
+    // 出错时也输出已经收集到的数据
+    OutputBuffer::standardOutput().flush();
+    if (collapsedFile.empty()) {
+        profiler.report(std::cerr);
+    } else if (!profiler.writeCollapsed(collapsedFile)) {
+        std::cerr << "Error: Could not write profile to " << collapsedFile << std::endl;
+        return false;
+    }
+    return ok;
+}
+
+bool PythonInterpreter::mapFiles(const std::string& script, const std::string& pattern, size_t jobs) {
+    OutputBuffer& out = OutputBuffer::standardOutput();
+    CompiledScript compiled;
     try {
-        std::string source = Utils::readFile(filename);
-        if (source.empty()) {
+        Utils::MappedFile source;
+        if (!source.open(script)) {
+            std::cerr << "Error: Could not open file " << script << std::endl;
             return false;
         }
+        compiled = EmbeddedInterpreter::compile(source.view(), script);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    
+    std::vector<std::string> files = Utils::expandGlob(pattern);
+    if (files.empty()) {
+        std::cerr << "Error: No files match " << pattern << std::endl;
+        return false;
+    }
+    
+    std::vector<WorkerPool::Job> batch(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        batch[i].script = compiled;
+        batch[i].inputs.emplace_back("__file__", Value(files[i]));
+        batch[i].inputFile = files[i];
+    }
+    
+    // 结果按文件顺序写出：错误信息排在这个文件已有的输出之后
+    bool ok = true;
+    WorkerPool pool(std::min(jobs ? jobs : (size_t)std::thread::hardware_concurrency(), files.size()));
+    pool.run(batch, [&](size_t index, WorkerPool::Result& result) {
+        out.write(result.output);
+        if (!result.ok) {
+            out.flush();
+            std::cerr << "Error: " << files[index] << ": " << result.error << std::endl;
+            ok = false;
+        }
+    });
+    out.flush();
+    return ok;
+}
+
+void PythonInterpreter::reportStats() {
+    if (!showStats) return;
+    // 先把输出写出去，这样计数里包括最后一次刷新，报告也排在输出之后
+    OutputBuffer::standardOutput().flush();
+    if (!Stats::enabled()) {
+        std::cerr << "Runtime counters were compiled out; rebuild with -DCPPYTHON_STATS=1\n";
+    }
+    std::cerr << "Runtime statistics:\n";
+    char line[96];
+    for (const auto& counter : executor->statistics()) {
+        std::snprintf(line, sizeof(line), "  %-22s %16llu\n", counter.first,
+                      (unsigned long long)counter.second);
+        std::cerr << line;
+    }
+    std::cerr.flush();
+}
+
+bool PythonInterpreter::runSource(Source kind, const std::string& source) {
+    try {
+        // 确保是文件执行模式（不输出表达式结果）
+        executor->setInteractiveMode(false);
         
-        Lexer lexer(source);
-        auto tokens = lexer.tokenize();
+        // 只有脚本文件有字节码缓存；虚拟机引擎先找磁盘上的缓存，命中时完全跳过前端
+        bool cacheable = kind == Source::SCRIPT && executor->getEngine() == Engine::VM;
+        if (cacheable) {
+            if (auto code = BytecodeCache::load(source, executor->symbolTable())) {
+                executor->run(*code);
+                return true;
+            }
+        }
         
-        Parser parser(tokens);
-        auto statements = parser.parse();
+        // 文件映射和AST都归编译单元所有，执行完一次性释放；-c的AST直接引用命令文本
+        CompilationUnit unit;
+        switch (kind) {
+            case Source::SCRIPT:
+                if (!unit.parseFile(source)) {
+                    std::cerr << "Error: Could not open file " << source << std::endl;
+                    return false;
+                }
+                break;
+            case Source::COMMAND:
+                unit.parse(source);
+                break;
+            case Source::STANDARD_INPUT:
+                if (!unit.parseStandardInput()) {
+                    std::cerr << "Error: Could not read program from standard input" << std::endl;
+                    return false;
+                }
+                break;
+        }
         
-        // 确保是文件执行模式（不输出表达式结果）
-        executor->setInteractiveMode(false);
-        executor->execute(statements);
+        if (executor->getEngine() == Engine::VM) {
+            // 编译结果不再引用语法树，先写缓存再执行
+            auto code = executor->compile(unit);
+            unit.release();
+            if (cacheable && writeBytecode) {
+                BytecodeCache::store(source, *code, executor->symbolTable());
+            }
+            executor->run(*code);
+        } else {
+            executor->execute(unit);
+            unit.release();
+        }
         
         return true;
     } catch (const std::exception& e) {
+        // 先写出已缓冲的输出，保证错误信息出现在它们之后
+        OutputBuffer::standardOutput().flush();
         std::cerr << "Error: " << e.what() << std::endl;
         return false;
     }
 }
 
+namespace {
+    enum class ReplCommand { NONE, EXIT, HELP, HELP_HINT, COPYRIGHT, CREDITS, LICENSE };
+
+    // 交互模式的内置命令：整行完全匹配时才生效，只在没有待续的输入时检查
+    constexpr KeyValue<ReplCommand> kReplCommandList[] = {
+        {"exit()", ReplCommand::EXIT},
+        {"quit()", ReplCommand::EXIT},
+        {"help()", ReplCommand::HELP},
+        {"help", ReplCommand::HELP_HINT},
+        {"copyright", ReplCommand::COPYRIGHT},
+        {"credits", ReplCommand::CREDITS},
+        {"license", ReplCommand::LICENSE},
+    };
+
+    constexpr PerfectHash<ReplCommand, 16> kReplCommands(kReplCommandList);
+
+    const char* replCommandText(ReplCommand command) {
+        switch (command) {
+            case ReplCommand::HELP:
+                return "Welcome to CPPython help utility!\n"
+                       "\n"
+                       "Supported features:\n"
+                       "  - Basic arithmetic operations (+, -, *, /, %)\n"
+                       "  - Variable assignment (x = 5)\n"
+                       "  - Print statements (print(\"Hello\"))\n"
+                       "  - Input function (input(\"prompt\"))\n"
+                       "  - F-strings (f\"{x}+{y}={x+y}\")\n"
+                       "  - String operations\n"
+                       "  - eval() and exec() functions\n"
+                       "  - Escape sequences (\\n, \\t, \\\\, etc.)\n"
+                       "  - List operations (one-dimensional and multi-dimensional)\n"
+                       "  - File operations (open, read, write, with statement)\n"
+                       "  - Built-in functions (str, int, float, bool, len, repr)\n"
+                       "  - Comments (# this is a comment)\n"
+                       "\n"
+                       "Type \"copyright\", \"credits\" or \"license\" for more information.\n"
+                       "Type \"exit()\" or \"quit()\" to exit.\n";
+            case ReplCommand::HELP_HINT:
+                return "Type help() for interactive help, or help(object) for help about object.\n";
+            case ReplCommand::COPYRIGHT:
+                return "Copyright (c) 2024 CPPython Project. All Rights Reserved.\n";
+            case ReplCommand::CREDITS:
+                return "    Thanks to Python Software Foundation for inspiration\n"
+                       "    Thanks to Guido van Rossum for creating Python\n"
+                       "    Thanks to all contributors to this project\n";
+            case ReplCommand::LICENSE:
+                return "CPPython is licensed under the MIT License.\n"
+                       "See https://opensource.org/licenses/MIT for more information.\n";
+            default:
+                return "";
+        }
+    }
+
+    // 交互输入的缓冲：逐行喂入，判断缓冲的内容是否已经是完整的语句。
+    // 每行单独做词法分析，括号深度、未结束的三引号字符串和块语句状态跨行保留；
+    // 以冒号结尾的行开始一个块（with语句），块一直延续到空行
+    class ReplInput {
+    private:
+        std::string buffer;
+        int depth = 0;          // 未闭合的括号数
+        char tripleQuote = 0;   // 未结束的三引号字符串的引号字符
+        bool inBlock = false;
+        TokenType lastToken = TokenType::NEWLINE;
+
+        void lexSegment(std::string_view text) {
+            Lexer lexer(text);
+            for (Token token = lexer.nextToken(); token.type != TokenType::EOF_TOKEN; token = lexer.nextToken()) {
+                switch (token.type) {
+                    case TokenType::LPAREN:
+                    case TokenType::LBRACKET:
+                    case TokenType::LBRACE:
+                        depth++;
+                        break;
+                    case TokenType::RPAREN:
+                    case TokenType::RBRACKET:
+                    case TokenType::RBRACE:
+                        if (depth > 0) depth--;
+                        break;
+                    default:
+                        break;
+                }
+                if (token.type != TokenType::NEWLINE) lastToken = token.type;
+            }
+        }
+
+        void scan(std::string_view text) {
+            while (!text.empty()) {
+                if (tripleQuote) {
+                    const char close[] = {tripleQuote, tripleQuote, tripleQuote, '\0'};
+                    size_t end = text.find(close);
+                    if (end == std::string_view::npos) return;
+                    text.remove_prefix(end + 3);
+                    tripleQuote = 0;
+                    lastToken = TokenType::STRING;
+                    continue;
+                }
+                // 三引号之前的部分交给词法分析器，之后的部分在字符串里
+                size_t open = std::min(text.find("\"\"\""), text.find("\'\'\'"));
+                lexSegment(text.substr(0, open));
+                if (open == std::string_view::npos) return;
+                tripleQuote = text[open];
+                text.remove_prefix(open + 3);
+            }
+        }
+
+    public:
+        // 加入一行，返回缓冲的输入是否可以执行了
+        bool feed(const std::string& line) {
+            if (inBlock && line.find_first_not_of(" \t\r") == std::string::npos) {
+                return true;
+            }
+            buffer += line;
+            if (!tripleQuote) lastToken = TokenType::NEWLINE;
+            scan(line);
+            // 括号内的换行按空格拼接（解析器不接受括号里的换行），三引号字符串里的换行保留
+            buffer += depth > 0 && !tripleQuote ? ' ' : '\n';
+            if (inBlock || tripleQuote || depth > 0) return false;
+            if (lastToken == TokenType::COLON) {
+                inBlock = true;
+                return false;
+            }
+            return true;
+        }
+
+        bool empty() const { return buffer.empty(); }
+        const std::string& text() const { return buffer; }
+
+        void clear() {
+            buffer.clear();
+            depth = 0;
+            tripleQuote = 0;
+            inBlock = false;
+        }
+    };
+}
+
 void PythonInterpreter::interactiveMode() {
-    std::cout << "CPPython 1.0.3 (simplified interpreter)" << std::endl;
-    std::cout << "Type \"help\", \"copyright\", \"credits\" or \"license\" for more information." << std::endl;
+    // 输入不是终端（例如由其他程序通过管道驱动）时不输出横幅和提示，也不逐行刷新
+    bool terminal = Utils::isTerminal(stdin);
+    OutputBuffer& out = OutputBuffer::standardOutput();
+    if (terminal) {
+        out.write("CPPython " CPPYTHON_VERSION " (simplified interpreter)\n");
+        out.write("Type \"help\", \"copyright\", \"credits\" or \"license\" for more information.\n");
+    }
+    
+    // 逐行从std::cin读，这时才值得解除和stdio的同步
+    Utils::enableFastIO();
     
     // 设置为交互模式
     executor->setInteractiveMode(true);
     
+    // 编译单元和输入缓冲在各条输入之间复用，符号表和变量一直保留在执行器里
+    CompilationUnit unit;
+    ReplInput input;
     std::string line;
+    
+    auto run = [&]() {
+        try {
+            unit.reset();
+            unit.parse(input.text());
+            executor->execute(unit);
+        } catch (const std::exception& e) {
+            out.flush();
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        input.clear();
+    };
+    
     while (true) {
-        std::cout << ">>> ";
-        std::cout.flush();
-        
-        if (!std::getline(std::cin, line)) {
-            break;
+        if (terminal) {
+            out.write(input.empty() ? ">>> " : "... ");
+            out.flush();
         }
         
-        if (line == "exit()" || line == "quit()") {
+        if (!std::getline(std::cin, line)) {
+            // 输入结束时执行还没结束的块
+            if (!input.empty()) run();
             break;
         }
         
-        // 添加help功能
-        if (line == "help()") {
-            std::cout << "Welcome to CPPython help utility!" << std::endl;
-            std::cout << std::endl;
-            std::cout << "Supported features:" << std::endl;
-            std::cout << "  - Basic arithmetic operations (+, -, *, /, %)" << std::endl;
-            std::cout << "  - Variable assignment (x = 5)" << std::endl;
-            std::cout << "  - Print statements (print(\"Hello\"))" << std::endl;
-            std::cout << "  - Input function (input(\"prompt\"))" << std::endl;
-            std::cout << "  - F-strings (f\"{x}+{y}={x+y}\")" << std::endl;
-            std::cout << "  - String operations" << std::endl;
-            std::cout << "  - eval() and exec() functions" << std::endl;
-            std::cout << "  - Escape sequences (\\n, \\t, \\\\, etc.)" << std::endl;
-            std::cout << "  - List operations (one-dimensional and multi-dimensional)" << std::endl;
-            std::cout << "  - File operations (open, read, write, with statement)" << std::endl;
-            std::cout << "  - Built-in functions (str, int, float, bool, len, repr)" << std::endl;
-            std::cout << "  - Comments (# this is a comment)" << std::endl;
-            std::cout << std::endl;
-            std::cout << "Type \"copyright\", \"credits\" or \"license\" for more information." << std::endl;
-            std::cout << "Type \"exit()\" or \"quit()\" to exit." << std::endl;
-            continue;
+        if (input.empty()) {
+            if (line.empty()) continue;
+            ReplCommand command = kReplCommands.find(line, ReplCommand::NONE);
+            if (command == ReplCommand::EXIT) break;
+            if (command != ReplCommand::NONE) {
+                out.write(replCommandText(command));
+                continue;
+            }
         }
         
-        if (line == "help") {
-            std::cout << "Type help() for interactive help, or help(object) for help about object." << std::endl;
-            continue;
-        }
-        
-        if (line == "copyright") {
-            std::cout << "Copyright (c) 2024 CPPython Project. All Rights Reserved." << std::endl;
-            continue;
-        }
-        
-        if (line == "credits") {
-            std::cout << "    Thanks to Python Software Foundation for inspiration" << std::endl;
-            std::cout << "    Thanks to Guido van Rossum for creating Python" << std::endl;
-            std::cout << "    Thanks to all contributors to this project" << std::endl;
-            continue;
-        }
-        
-        if (line == "license") {
-            std::cout << "CPPython is licensed under the MIT License." << std::endl;
-            std::cout << "See https://opensource.org/licenses/MIT for more information." << std::endl;
-            continue;
-        }
-        
-        if (line.empty()) continue;
-        
-        try {
-            Lexer lexer(line);
-            auto tokens = lexer.tokenize();
-            
-            Parser parser(tokens);
-            auto statements = parser.parse();
-            
-            executor->execute(statements);
-        } catch (const std::exception& e) {
-            std::cerr << "Error: " << e.what() << std::endl;
+        if (input.feed(line)) {
+            run();
         }
     }
+    
+    out.flush();
+    reportStats();
 }
 
 void PythonInterpreter::showHelp() {
     std::cout << "usage: python [option] ... [-c cmd | -m mod | file | -] [arg] ...\n";
     std::cout << "Options and arguments:\n";
+    std::cout << "-B             : don't write .cppyc files to __pycache__ for scripts\n";
+    std::cout << "-c cmd         : program passed in as string\n";
     std::cout << "-h, --help     : print this help message and exit\n";
+    std::cout << "--stats        : print runtime counters (allocations, copies, I/O) to stderr at exit\n";
+    std::cout << "--profile      : report per-line and per-builtin timings to stderr when the script ends\n";
+    std::cout << "--profile=FILE : write flamegraph-compatible collapsed stacks (microseconds) to FILE\n";
     std::cout << "-v, --version  : print the Python version number and exit\n";
+    std::cout << "--engine=ENG   : execution engine: vm (bytecode, default) or ast (tree-walking)\n";
+    std::cout << "--map GLOB     : run the script once per file matching GLOB, in parallel; __file__ is the\n";
+    std::cout << "                 file's path and input() reads its lines; outputs are written in file order;\n";
+    std::cout << "                 always runs on the vm engine\n";
+    std::cout << "--jobs N       : number of worker threads for --map (default: one per hardware thread)\n";
     std::cout << "file           : program read from script file\n";
     std::cout << "-              : program read from stdin\n";
     std::cout << "arg ...        : arguments passed to program in sys.argv[1:]\n";
 }
 
 void PythonInterpreter::showVersion() {
-    std::cout << "CPPython 1.0.3 (simplified interpreter)" << std::endl;
+    std::cout << "CPPython " CPPYTHON_VERSION " (simplified interpreter)" << std::endl;
 }
\ No newline at end of file
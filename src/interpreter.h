@@ -4,17 +4,45 @@
 #include <string>
 #include <memory>
 
+#define CPPYTHON_VERSION "1.0.3"
+
 class Executor;
+class Profiler;
+enum class Engine;
 
 class PythonInterpreter {
 private:
     std::unique_ptr<Executor> executor;
+    bool writeBytecode;  // 是否把脚本的编译结果写入__pycache__
+    bool profiling;
+    bool showStats;  // 结束时向标准错误输出运行时计数器
+    std::string collapsedFile;  // 非空时把折叠栈写到这个文件，否则向标准错误输出报告
+    
+    // 程序的来源：脚本文件、-c给出的命令或标准输入
+    enum class Source { SCRIPT, COMMAND, STANDARD_INPUT };
+    
+    bool execute(Source kind, const std::string& source);
+    bool runSource(Source kind, const std::string& source);
+    void reportStats();
     
 public:
     PythonInterpreter();
     ~PythonInterpreter();
     
+    void setEngine(Engine engine);
+    void setWriteBytecode(bool enabled) { writeBytecode = enabled; }
+    // 执行脚本时记录每行和每个内置函数的耗时
+    void enableProfiling(const std::string& collapsedOutput);
+    void enableStats() { showStats = true; }
     bool executeFile(const std::string& filename);
+    // -c：执行命令行上给出的程序，command在执行期间必须保持有效
+    bool executeCommand(const std::string& command);
+    // -：读入标准输入的全部内容，像脚本文件一样执行（不输出表达式的值）
+    bool executeStdin();
+    // 批量模式：脚本只编译一次，对pattern匹配到的每个文件在线程池上各执行一次
+    // （__file__是文件路径，input()逐行读这个文件），输出按文件顺序写出
+    // jobs为0时使用硬件线程数；任何一个文件出错都返回false
+    bool mapFiles(const std::string& script, const std::string& pattern, size_t jobs);
     void interactiveMode();
     void showHelp();
     void showVersion();
@@ -0,0 +1,92 @@
+#include "kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPPYTHON_SSE2 1
+#endif
+
+namespace {
+    // 逐项比较，和Python一样只在严格更小（更大）时替换
+    template<bool Maximum>
+    double scan(const double* data, size_t count) {
+        double result = data[0];
+        for (size_t i = 1; i < count; i++) {
+            if (Maximum ? data[i] > result : data[i] < result) result = data[i];
+        }
+        return result;
+    }
+
+    template<bool Maximum>
+    double extreme(const double* data, size_t count) {
+        size_t i = 0;
+        double result;
+#ifdef CPPYTHON_SSE2
+        if (count < 4) return scan<Maximum>(data, count);
+        __m128d best = _mm_loadu_pd(data);
+        __m128d nan = _mm_cmpunord_pd(best, best);
+        for (i = 2; i + 2 <= count; i += 2) {
+            __m128d v = _mm_loadu_pd(data + i);
+            nan = _mm_or_pd(nan, _mm_cmpunord_pd(v, v));
+            best = Maximum ? _mm_max_pd(best, v) : _mm_min_pd(best, v);
+        }
+        if (_mm_movemask_pd(nan)) return scan<Maximum>(data, count);
+        double lanes[2];
+        _mm_storeu_pd(lanes, best);
+        result = (Maximum ? lanes[1] > lanes[0] : lanes[1] < lanes[0]) ? lanes[1] : lanes[0];
+#else
+        result = data[0];
+        for (i = 1; i < count; i++) {
+            if (data[i] != data[i]) return scan<Maximum>(data, count);
+            if (Maximum ? data[i] > result : data[i] < result) result = data[i];
+        }
+#endif
+        for (; i < count; i++) {
+            if (data[i] != data[i]) return scan<Maximum>(data, count);
+            if (Maximum ? data[i] > result : data[i] < result) result = data[i];
+        }
+        // 0.0和-0.0相等，返回第一个等于零的元素才和Python一致
+        if (result == 0.0) {
+            for (i = 0; data[i] != 0.0; i++) {}
+            result = data[i];
+        }
+        return result;
+    }
+}
+
+double Kernels::sum(const double* data, size_t count) {
+    size_t i = 0;
+    double total;
+#ifdef CPPYTHON_SSE2
+    // 两个寄存器共四路：第k路累加下标模4为k的元素
+    __m128d low = _mm_setzero_pd();
+    __m128d high = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        low = _mm_add_pd(low, _mm_loadu_pd(data + i));
+        high = _mm_add_pd(high, _mm_loadu_pd(data + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(low, high));
+    total = lanes[0] + lanes[1];
+#else
+    double lanes[4] = {0.0, 0.0, 0.0, 0.0};
+    for (; i + 4 <= count; i += 4) {
+        lanes[0] += data[i];
+        lanes[1] += data[i + 1];
+        lanes[2] += data[i + 2];
+        lanes[3] += data[i + 3];
+    }
+    total = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+#endif
+    for (; i < count; i++) {
+        total += data[i];
+    }
+    return total;
+}
+
+double Kernels::min(const double* data, size_t count) {
+    return extreme<false>(data, count);
+}
+
+double Kernels::max(const double* data, size_t count) {
+    return extreme<true>(data, count);
+}
@@ -0,0 +1,18 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+
+// 紧凑数字列表上的批量运算（sum/min/max使用）
+// 有SSE2时一次处理两个double，否则用四路累加；两种实现的累加顺序相同，
+// 结果在各平台上一致
+namespace Kernels {
+    // 四路分组累加，和逐项顺序累加相比可能在最后一位上不同
+    double sum(const double* data, size_t count);
+    // 与Python的min()/max()相同：取第一个最小（最大）的元素，含NaN时按顺序比较。
+    // count必须大于0
+    double min(const double* data, size_t count);
+    double max(const double* data, size_t count);
+}
+
+#endif
@@ -1,10 +1,11 @@
 #include "lexer.h"
+#include "perfect_hash.h"
 #include <cctype>
 #include <stdexcept>
 #include <algorithm>
 
-Lexer::Lexer(const std::string& sourceCode) 
-    : source(sourceCode), pos(0), line(1), col(0) {
+Lexer::Lexer(std::string_view sourceCode, int startLine, int startCol) 
+    : source(sourceCode), pos(0), line(startLine), col(startCol), tokenLine(startLine), tokenCol(startCol) {
 }
 
 char Lexer::currentChar() const {
@@ -34,8 +35,9 @@ void Lexer::advance() {
     }
 }
 
-std::string Lexer::processEscapeSequences(const std::string& str) {
+std::string Lexer::processEscapeSequences(std::string_view str) {
     std::string result;
+    result.reserve(str.length());
     for (size_t i = 0; i < str.length(); i++) {
         if (str[i] == '\\' && i + 1 < str.length()) {
             i++;
@@ -81,14 +83,14 @@ Token Lexer::readString() {
             advance();
         }
         
-        std::string value = source.substr(start, pos - start);
-        // 处理三引号字符串中的转义符
-        value = processEscapeSequences(value);
+        // 直接引用源码，含转义符时由使用者解码
+        std::string_view value = source.substr(start, pos - start);
+        bool escaped = value.find('\\') != std::string_view::npos;
         if (pos + 2 < source.length()) {
             advance(); advance(); advance(); // 跳过结束的三引号
         }
         
-        return Token(TokenType::STRING, value, line, col);
+        return Token(TokenType::STRING, value, tokenLine, tokenCol, escaped);
     } else if (quote == '\'' && pos + 1 < source.length() && 
                currentChar() == '\'' && peekChar() == '\'') {
         // 三引号字符串（单引号）
@@ -103,20 +105,22 @@ Token Lexer::readString() {
             advance();
         }
         
-        std::string value = source.substr(start, pos - start);
-        // 处理三引号字符串中的转义符
-        value = processEscapeSequences(value);
+        // 直接引用源码，含转义符时由使用者解码
+        std::string_view value = source.substr(start, pos - start);
+        bool escaped = value.find('\\') != std::string_view::npos;
         if (pos + 2 < source.length()) {
             advance(); advance(); advance(); // 跳过结束的三引号
         }
         
-        return Token(TokenType::STRING, value, line, col);
+        return Token(TokenType::STRING, value, tokenLine, tokenCol, escaped);
     } else {
         // 普通字符串
         size_t start = pos;
+        bool escaped = false;
         
         while (currentChar() != quote && currentChar() != '\0' && currentChar() != '\n') {
             if (currentChar() == '\\' && peekChar() != '\0') {
+                escaped = true;
                 advance(); // 跳过反斜杠
                 advance(); // 跳过转义字符
             } else {
@@ -124,17 +128,21 @@ Token Lexer::readString() {
             }
         }
         
-        std::string value = source.substr(start, pos - start);
-        // 处理普通字符串中的转义符
-        value = processEscapeSequences(value);
+        std::string_view value = source.substr(start, pos - start);
         if (currentChar() == quote) {
             advance(); // 跳过结束引号
         }
         
-        return Token(TokenType::STRING, value, line, col);
+        return Token(TokenType::STRING, value, tokenLine, tokenCol, escaped);
     }
 }
 
+Token Lexer::singleCharToken(TokenType type, const char* text) {
+    Token token(type, text, tokenLine, tokenCol);
+    advance();
+    return token;
+}
+
 Token Lexer::readNumber() {
     size_t start = pos;
     bool hasDot = false;
@@ -147,7 +155,7 @@ Token Lexer::readNumber() {
         advance();
     }
     
-    return Token(TokenType::NUMBER, source.substr(start, pos - start), line, col);
+    return Token(TokenType::NUMBER, source.substr(start, pos - start), tokenLine, tokenCol);
 }
 
 Token Lexer::readIdentifier() {
@@ -156,35 +164,37 @@ Token Lexer::readIdentifier() {
         advance();
     }
     
-    std::string identifier = source.substr(start, pos - start);
+    std::string_view identifier = source.substr(start, pos - start);
     TokenType type = getKeywordType(identifier);
     
-    return Token(type, identifier, line, col);
+    return Token(type, identifier, tokenLine, tokenCol);
 }
 
-TokenType Lexer::getKeywordType(const std::string& identifier) {
-    if (identifier == "print") return TokenType::PRINT;
-    if (identifier == "input") return TokenType::INPUT;
-    if (identifier == "if") return TokenType::IF;
-    if (identifier == "else") return TokenType::ELSE;
-    if (identifier == "for") return TokenType::FOR;
-    if (identifier == "while") return TokenType::WHILE;
-    if (identifier == "def") return TokenType::DEF;
-    if (identifier == "return") return TokenType::RETURN;
-    if (identifier == "eval") return TokenType::IDENTIFIER;
-    if (identifier == "exec") return TokenType::IDENTIFIER;
-    if (identifier == "with") return TokenType::WITH;    // 添加with关键字
-    if (identifier == "as") return TokenType::AS;       // 添加as关键字
-    if (identifier == "True") return TokenType::TRUE;
-    if (identifier == "False") return TokenType::FALSE;
-    if (identifier == "None") return TokenType::NONE;
-    
-    return TokenType::IDENTIFIER;
+namespace {
+    // input/eval/exec不是关键字，按普通标识符（内置函数）处理
+    constexpr KeyValue<TokenType> kKeywordList[] = {
+        {"print", TokenType::PRINT},
+        {"if", TokenType::IF},
+        {"else", TokenType::ELSE},
+        {"for", TokenType::FOR},
+        {"while", TokenType::WHILE},
+        {"def", TokenType::DEF},
+        {"return", TokenType::RETURN},
+        {"with", TokenType::WITH},    // 添加with关键字
+        {"as", TokenType::AS},        // 添加as关键字
+        {"True", TokenType::TRUE},
+        {"False", TokenType::FALSE},
+        {"None", TokenType::NONE},
+    };
+
+    constexpr PerfectHash<TokenType, 32> kKeywords(kKeywordList);
 }
 
-std::vector<Token> Lexer::tokenize() {
-    std::vector<Token> tokens;
-    
+TokenType Lexer::getKeywordType(std::string_view identifier) {
+    return kKeywords.find(identifier, TokenType::IDENTIFIER);
+}
+
+Token Lexer::nextToken() {
     while (pos < source.length()) {
         // 跳过空白字符（除了换行符）
         while (pos < source.length() && std::isspace(currentChar()) && currentChar() != '\n') {
@@ -193,10 +203,12 @@ std::vector<Token> Lexer::tokenize() {
         
         if (currentChar() == '\0') break;
         
+        // token的位置记在它的第一个字符上
+        tokenLine = line;
+        tokenCol = col;
+        
         if (currentChar() == '\n') {
-            tokens.emplace_back(TokenType::NEWLINE, "\n", line, col);
-            advance();
-            continue;
+            return singleCharToken(TokenType::NEWLINE, "\n");
         }
         
         if (currentChar() == '#') {
@@ -205,8 +217,9 @@ std::vector<Token> Lexer::tokenize() {
                 advance();
             }
             if (currentChar() == '\n') {
-                tokens.emplace_back(TokenType::NEWLINE, "\n", line, col);
-                advance();
+                tokenLine = line;
+                tokenCol = col;
+                return singleCharToken(TokenType::NEWLINE, "\n");
             }
             continue;
         }
@@ -215,109 +228,97 @@ std::vector<Token> Lexer::tokenize() {
         if ((currentChar() == 'f' || currentChar() == 'F') && 
             pos + 1 < source.length() && 
             (source[pos + 1] == '"' || source[pos + 1] == '\'')) {
-            char f_char = currentChar();
             advance(); // 跳过'f'
             char quote = currentChar();
             advance(); // 跳过引号
             
             size_t start = pos;
-            std::string value = "";
             
-            // 读取f-string内容，特别处理大括号和转义符
+            // 跳过f-string内容，特别处理大括号和转义符；模板原样引用源码
             while (currentChar() != quote && currentChar() != '\0' && currentChar() != '\n') {
                 if (currentChar() == '\\' && peekChar() != '\0') {
-                    // 处理转义字符
-                    value += currentChar();
+                    // 转义字符原样保留
                     advance();
-                    value += currentChar();
                     advance();
                 } else if (currentChar() == '{') {
                     // 开始表达式
-                    value += currentChar();
                     advance();
                     // 读取直到匹配的'}'
                     int brace_count = 1;
                     while (currentChar() != '\0' && brace_count > 0) {
                         if (currentChar() == '{') brace_count++;
                         if (currentChar() == '}') brace_count--;
-                        value += currentChar();
                         advance();
                     }
                 } else {
-                    value += currentChar();
                     advance();
                 }
             }
             
+            std::string_view value = source.substr(start, pos - start);
             if (currentChar() == quote) {
                 advance(); // 跳过结束引号
             }
             
-            tokens.emplace_back(TokenType::F_STRING, value, line, col);
-            continue;
+            return Token(TokenType::F_STRING, value, tokenLine, tokenCol);
         }
         
         if (std::isdigit(currentChar())) {
-            tokens.push_back(readNumber());
-            continue;
+            return readNumber();
         }
         
         if (currentChar() == '"' || currentChar() == '\'') {
-            tokens.push_back(readString());
-            continue;
+            return readString();
         }
         
         if (std::isalpha(currentChar()) || currentChar() == '_') {
-            tokens.push_back(readIdentifier());
-            continue;
+            return readIdentifier();
         }
         
         // 操作符和分隔符
         switch (currentChar()) {
-            case '+': tokens.emplace_back(TokenType::PLUS, "+", line, col); advance(); break;
-            case '-': tokens.emplace_back(TokenType::MINUS, "-", line, col); advance(); break;
-            case '*': tokens.emplace_back(TokenType::MULTIPLY, "*", line, col); advance(); break;
-            case '/': tokens.emplace_back(TokenType::DIVIDE, "/", line, col); advance(); break;
-            case '%': tokens.emplace_back(TokenType::MODULO, "%", line, col); advance(); break;
+            case '+': return singleCharToken(TokenType::PLUS, "+");
+            case '-': return singleCharToken(TokenType::MINUS, "-");
+            case '*': return singleCharToken(TokenType::MULTIPLY, "*");
+            case '/': return singleCharToken(TokenType::DIVIDE, "/");
+            case '%': return singleCharToken(TokenType::MODULO, "%");
             case '=': 
                 if (peekChar() == '=') {
                     advance(); advance();
-                    tokens.emplace_back(TokenType::EQUAL, "==", line, col);
-                } else {
-                    tokens.emplace_back(TokenType::ASSIGN, "=", line, col);
-                    advance();
+                    return Token(TokenType::EQUAL, "==", tokenLine, tokenCol);
                 }
-                break;
+                return singleCharToken(TokenType::ASSIGN, "=");
             case '!':
                 if (peekChar() == '=') {
                     advance(); advance();
-                    tokens.emplace_back(TokenType::NOT_EQUAL, "!=", line, col);
-                } else {
-                    advance();
+                    return Token(TokenType::NOT_EQUAL, "!=", tokenLine, tokenCol);
                 }
-                break;
-            case '<':
-                tokens.emplace_back(TokenType::LESS, "<", line, col);
                 advance();
                 break;
-            case '>':
-                tokens.emplace_back(TokenType::GREATER, ">", line, col);
-                advance();
-                break;
-            case '(': tokens.emplace_back(TokenType::LPAREN, "(", line, col); advance(); break;
-            case ')': tokens.emplace_back(TokenType::RPAREN, ")", line, col); advance(); break;
-            case '{': tokens.emplace_back(TokenType::LBRACE, "{", line, col); advance(); break;
-            case '}': tokens.emplace_back(TokenType::RBRACE, "}", line, col); advance(); break;
-            case '[': tokens.emplace_back(TokenType::LBRACKET, "[", line, col); advance(); break;
-            case ']': tokens.emplace_back(TokenType::RBRACKET, "]", line, col); advance(); break;
-            case ',': tokens.emplace_back(TokenType::COMMA, ",", line, col); advance(); break;
-            case '.': tokens.emplace_back(TokenType::DOT, ".", line, col); advance(); break;
-            case ':': tokens.emplace_back(TokenType::COLON, ":", line, col); advance(); break;
-            case ';': tokens.emplace_back(TokenType::SEMICOLON, ";", line, col); advance(); break;
+            case '<': return singleCharToken(TokenType::LESS, "<");
+            case '>': return singleCharToken(TokenType::GREATER, ">");
+            case '(': return singleCharToken(TokenType::LPAREN, "(");
+            case ')': return singleCharToken(TokenType::RPAREN, ")");
+            case '{': return singleCharToken(TokenType::LBRACE, "{");
+            case '}': return singleCharToken(TokenType::RBRACE, "}");
+            case '[': return singleCharToken(TokenType::LBRACKET, "[");
+            case ']': return singleCharToken(TokenType::RBRACKET, "]");
+            case ',': return singleCharToken(TokenType::COMMA, ",");
+            case '.': return singleCharToken(TokenType::DOT, ".");
+            case ':': return singleCharToken(TokenType::COLON, ":");
+            case ';': return singleCharToken(TokenType::SEMICOLON, ";");
             default: advance(); break;
         }
     }
     
-    tokens.emplace_back(TokenType::EOF_TOKEN, "", line, col);
+    return Token(TokenType::EOF_TOKEN, "", line, col);
+}
+
+std::vector<Token> Lexer::tokenize() {
+    std::vector<Token> tokens;
+    while (true) {
+        tokens.push_back(nextToken());
+        if (tokens.back().type == TokenType::EOF_TOKEN) break;
+    }
     return tokens;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define LEXER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class TokenType {
@@ -24,36 +25,51 @@ enum class TokenType {
     NEWLINE, EOF_TOKEN, COMMENT
 };
 
+// token文本是指向源码（或静态字符串）的视图，Token本身可平凡复制
+// 含转义符的字符串保留原始文本并标记escaped，由使用者按需解码
 struct Token {
     TokenType type;
-    std::string value;
+    bool escaped;
+    std::string_view value;
     int line;
     int col;
     
-    Token(TokenType t, const std::string& v, int l = 0, int c = 0)
-        : type(t), value(v), line(l), col(c) {}
+    Token() : type(TokenType::EOF_TOKEN), escaped(false), line(0), col(0) {}
+    Token(TokenType t, std::string_view v, int l = 0, int c = 0, bool esc = false)
+        : type(t), escaped(esc), value(v), line(l), col(c) {}
 };
 
+// 词法分析器不复制源码，调用者要保证源码在token使用期间有效
 class Lexer {
 private:
-    std::string source;
+    std::string_view source;
     size_t pos;
     int line;
     int col;
+    // 当前token第一个字符的位置
+    int tokenLine;
+    int tokenCol;
     
     char currentChar() const;
     char peekChar() const;
     char peekChar2() const;
     void advance();
+    Token singleCharToken(TokenType type, const char* text);
     Token readNumber();
     Token readString();
     Token readIdentifier();
-    TokenType getKeywordType(const std::string& identifier);
-    std::string processEscapeSequences(const std::string& str);
+    TokenType getKeywordType(std::string_view identifier);
     
 public:
-    Lexer(const std::string& sourceCode);
+    // startLine/startCol：源码片段在原文件中的起始位置（f-string里的表达式使用）
+    explicit Lexer(std::string_view sourceCode, int startLine = 1, int startCol = 0);
+
+    // 流式接口：每次返回下一个token，结束后一直返回EOF_TOKEN
+    Token nextToken();
+    // 一次性切分整段源码
     std::vector<Token> tokenize();
+
+    static std::string processEscapeSequences(std::string_view str);
 };
 
 #endif
\ No newline at end of file
@@ -1,33 +1,106 @@
 #include "interpreter.h"
+#include "executor.h"
 #include "utils.h"
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
+// 基准测试等自带main()的程序和解释器源码一起编译时定义CPPYTHON_NO_MAIN
+#ifndef CPPYTHON_NO_MAIN
 int main(int argc, char* argv[]) {
-    // 启用快速IO
-    Utils::enableFastIO();
-    
+    // 标准流的同步等到第一次用std::cin读输入时才解除（Utils::enableFastIO），
+    // 只跑一小段脚本的进程不为它付启动开销
     PythonInterpreter interpreter;
-    
-    if (argc == 1) {
-        // 交互模式
-        interpreter.interactiveMode();
-    } else if (argc == 2) {
-        std::string arg = argv[1];
+    std::string script;
+    std::string command;
+    bool hasCommand = false;  // -c cmd
+    bool fromStdin = false;   // -
+    bool program = false;     // 程序只能给一个：-c cmd、-或者脚本文件
+    std::string mapPattern;
+    size_t jobs = 0;
+    bool mapping = false;
+    bool instrumented = false;  // --stats/--profile只支持单个脚本
+    bool astEngine = false;     // --map只在虚拟机上执行
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
         if (arg == "-h" || arg == "--help") {
             interpreter.showHelp();
+            return 0;
         } else if (arg == "-v" || arg == "--version") {
             interpreter.showVersion();
-        } else {
-            // 执行Python文件
-            if (!interpreter.executeFile(arg)) {
+            return 0;
+        } else if (arg == "-B") {
+            interpreter.setWriteBytecode(false);
+        } else if (arg == "--stats") {
+            interpreter.enableStats();
+            instrumented = true;
+        } else if (arg == "--profile") {
+            interpreter.enableProfiling("");
+            instrumented = true;
+        } else if (arg.compare(0, 10, "--profile=") == 0 && arg.size() > 10) {
+            interpreter.enableProfiling(arg.substr(10));
+            instrumented = true;
+        } else if (arg == "--map" && i + 1 < argc && !mapping) {
+            mapPattern = argv[++i];
+            mapping = true;
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            char* end = nullptr;
+            long count = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || count <= 0) {
+                std::cerr << "Error: --jobs expects a positive number" << std::endl;
                 return 1;
             }
+            jobs = (size_t)count;
+        } else if (arg == "--engine=vm") {
+            interpreter.setEngine(Engine::VM);
+            astEngine = false;
+        } else if (arg == "--engine=ast") {
+            interpreter.setEngine(Engine::AST);
+            astEngine = true;
+        } else if (arg == "-c" && i + 1 < argc && !program) {
+            command = argv[++i];
+            hasCommand = true;
+            program = true;
+        } else if (arg == "-" && !program) {
+            fromStdin = true;
+            program = true;
+        } else if (!program && arg != "-c" && arg.compare(0, 2, "--") != 0) {
+            script = arg;
+            program = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-B] [--engine=vm|ast] [--stats] [--profile[=FILE]] [--map GLOB [--jobs N]] [-c cmd | - | script.py] [-h|--help] [-v|--version]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (mapping) {
+        // 批量模式总是在虚拟机上执行，也不写字节码缓存
+        if (script.empty() || instrumented) {
+            std::cerr << "Error: --map needs a script file and cannot be combined with --stats or --profile" << std::endl;
+            return 1;
         }
+        if (astEngine) {
+            std::cerr << "Error: --map always runs on the VM and cannot be combined with --engine=ast" << std::endl;
+            return 1;
+        }
+        return interpreter.mapFiles(script, mapPattern, jobs) ? 0 : 1;
+    }
+
+    if (hasCommand) {
+        return interpreter.executeCommand(command) ? 0 : 1;
+    } else if (fromStdin) {
+        return interpreter.executeStdin() ? 0 : 1;
+    } else if (script.empty()) {
+        // 交互模式
+        interpreter.interactiveMode();
     } else {
-        std::cerr << "Usage: " << argv[0] << " [script.py] [-h|--help] [-v|--version]" << std::endl;
-        return 1;
+        // 执行Python文件
+        if (!interpreter.executeFile(script)) {
+            return 1;
+        }
     }
-    
+
     return 0;
-}
\ No newline at end of file
+}
+#endif
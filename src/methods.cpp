@@ -0,0 +1,160 @@
+#include "methods.h"
+#include "perfect_hash.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+    constexpr KeyValue<Method> kMethodList[] = {
+        {"read", Method::READ},
+        {"readline", Method::READLINE},
+        {"readlines", Method::READLINES},
+        {"write", Method::WRITE},
+        {"flush", Method::FLUSH},
+        {"close", Method::CLOSE},
+        {"decode", Method::DECODE},
+        {"join", Method::JOIN},
+    };
+
+    constexpr PerfectHash<Method, 16> kMethods(kMethodList);
+
+    Value::FileObject* fileOf(const Value& self) {
+        Value::FileObject* file = self.fileObject();
+        if (!file) {
+            throw std::runtime_error("I/O operation on closed file");
+        }
+        return file;
+    }
+
+    // 文件对象的方法：read([n])、readline()、readlines()、write(s)、flush()、close()
+    Value fileRead(const Value& self, const Value* args, size_t argc) {
+        Value::FileObject* file = fileOf(self);
+        long long size = -1;
+        if (argc > 0 && args[0].type != Value::Type::NONE) {
+            size = (long long)args[0].toNumber();
+        }
+        // 二进制模式返回字节串，读到末尾时直接映射文件
+        if (file->is_binary) {
+            return size < 0 ? file->readMapped() : Value::bytes(file->read(size));
+        }
+        return Value(file->read(size));
+    }
+
+    Value fileReadline(const Value& self, const Value*, size_t) {
+        Value::FileObject* file = fileOf(self);
+        if (file->is_binary) {
+            return Value::bytes(file->readline());
+        }
+        return Value(file->readline());
+    }
+
+    Value fileReadlines(const Value& self, const Value*, size_t) {
+        Value::FileObject* file = fileOf(self);
+        Value::List lines = file->readlines();
+        if (file->is_binary) {
+            for (auto& line : lines) {
+                line = Value::bytes(line.stringValue());
+            }
+        }
+        return Value(std::move(lines));
+    }
+
+    Value fileWrite(const Value& self, const Value* args, size_t argc) {
+        Value::FileObject* file = fileOf(self);
+        if (argc < 1) {
+            throw std::runtime_error("write() takes exactly one argument");
+        }
+        if (args[0].type == Value::Type::STRING) {
+            return Value((double)file->write(args[0].stringValue()));
+        }
+        if (args[0].type == Value::Type::BYTES) {
+            return Value((double)file->write(args[0].bytesValue()));
+        }
+        return Value((double)file->write(args[0].toString())); // 返回写入的字符数
+    }
+
+    Value fileFlush(const Value& self, const Value*, size_t) {
+        fileOf(self)->flush();
+        return Value();
+    }
+
+    Value fileClose(const Value& self, const Value*, size_t) {
+        fileOf(self)->close();
+        return Value(); // 返回None
+    }
+
+    Value bytesDecode(const Value& self, const Value*, size_t) {
+        return Value(self.bytesValue());
+    }
+
+    // sep.join(list)：先算出总长度，结果只分配一次
+    Value stringJoin(const Value& self, const Value* args, size_t argc) {
+        if (argc != 1 || args[0].type != Value::Type::LIST) {
+            throw std::runtime_error("join() argument must be a list");
+        }
+        const std::string& separator = self.stringValue();
+        const Value& list = args[0];
+        size_t count = list.listSize();
+        if (count == 0) {
+            return Value("");
+        }
+        if (list.listStorage() != Value::ListStorage::BOXED) {
+            throw std::runtime_error("sequence item 0: expected str instance");
+        }
+        const Value* items = list.listBoxed();
+        size_t total = separator.size() * (count - 1);
+        for (size_t i = 0; i < count; i++) {
+            if (items[i].type != Value::Type::STRING) {
+                throw std::runtime_error("sequence item " + std::to_string(i) + ": expected str instance");
+            }
+            total += items[i].stringValue().size();
+        }
+        std::string result;
+        result.reserve(total);
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) result += separator;
+            result += items[i].stringValue();
+        }
+        return Value(std::move(result));
+    }
+}
+
+Method Methods::lookup(std::string_view name) {
+    return kMethods.find(name, Method::NONE);
+}
+
+const char* Methods::name(Method id) {
+    switch (id) {
+        case Method::READ: return "read";
+        case Method::READLINE: return "readline";
+        case Method::READLINES: return "readlines";
+        case Method::WRITE: return "write";
+        case Method::FLUSH: return "flush";
+        case Method::CLOSE: return "close";
+        case Method::DECODE: return "decode";
+        case Method::JOIN: return "join";
+        case Method::NONE:
+        default:
+            return "";
+    }
+}
+
+MethodHandler Methods::resolve(Value::Type type, Method id) {
+    switch (type) {
+        case Value::Type::FILE_OBJECT:
+            switch (id) {
+                case Method::READ: return fileRead;
+                case Method::READLINE: return fileReadline;
+                case Method::READLINES: return fileReadlines;
+                case Method::WRITE: return fileWrite;
+                case Method::FLUSH: return fileFlush;
+                case Method::CLOSE: return fileClose;
+                default: return nullptr;
+            }
+        case Value::Type::BYTES:
+            return id == Method::DECODE ? bytesDecode : nullptr;
+        case Value::Type::STRING:
+            return id == Method::JOIN ? stringJoin : nullptr;
+        default:
+            return nullptr;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef METHODS_H
+#define METHODS_H
+
+#include "value.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 方法编号：文件对象、字节串和字符串上支持的方法
+enum class Method : uint8_t {
+    NONE,  // 不认识的方法名
+    READ, READLINE, READLINES, WRITE, FLUSH, CLOSE,
+    DECODE, JOIN
+};
+
+// 方法的实现：接收者和已求值的参数
+using MethodHandler = Value (*)(const Value& self, const Value* args, size_t argc);
+
+// 调用点的内联缓存：记住上次接收者的类型和解析出的实现，
+// 类型相同时直接调用，不同时重新解析（AST节点和字节码都内嵌这个结构）
+struct MethodCache {
+    Value::Type type = Value::Type::NONE;
+    MethodHandler handler = nullptr;  // nullptr表示还没解析过
+};
+
+namespace Methods {
+    Method lookup(std::string_view name);
+    const char* name(Method id);
+    // type上名为id的方法，不存在时返回nullptr
+    MethodHandler resolve(Value::Type type, Method id);
+}
+
+#endif
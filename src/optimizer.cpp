@@ -0,0 +1,114 @@
+#include "optimizer.h"
+#include "executor.h"
+
+namespace {
+
+bool isConstant(const ExprNode* expr) {
+    auto literal = nodeCast<const LiteralExpr>(expr);
+    return literal && (literal->type == TokenType::NUMBER || literal->type == TokenType::STRING ||
+                       literal->type == TokenType::TRUE || literal->type == TokenType::FALSE);
+}
+
+Value constantValue(const LiteralExpr* literal) {
+    switch (literal->type) {
+        case TokenType::NUMBER: return Value(literal->number);
+        case TokenType::TRUE: return Value(true);
+        case TokenType::FALSE: return Value(false);
+        default: return Value(literal->value);
+    }
+}
+
+}
+
+Optimizer::Optimizer(Arena& nodeArena) : arena(nodeArena) {}
+
+// 把折叠结果变回字面量节点，无法用字面量表示的结果返回nullptr
+ExprNode* Optimizer::makeLiteral(const Value& value) {
+    switch (value.type) {
+        case Value::Type::NUMBER:
+            return arena.make<LiteralExpr>(value.number, arena.copyString(value.toString()));
+        case Value::Type::STRING:
+            return arena.make<LiteralExpr>(arena.copyString(value.stringValue()), TokenType::STRING);
+        case Value::Type::BOOLEAN:
+            return arena.make<LiteralExpr>(value.boolean ? "True" : "False",
+                                           value.boolean ? TokenType::TRUE : TokenType::FALSE);
+        default:
+            return nullptr;
+    }
+}
+
+ExprNode* Optimizer::fold(ExprNode* expr) {
+    if (auto binary = nodeCast<BinaryExpr>(expr)) {
+        binary->left = fold(binary->left);
+        binary->right = fold(binary->right);
+
+        if (isConstant(binary->left) && isConstant(binary->right)) {
+            // 使用与执行时相同的运算语义，保证折叠前后结果一致
+            Value result;
+            try {
+                result = Executor::applyBinary(binary->op,
+                    constantValue(static_cast<const LiteralExpr*>(binary->left)),
+                    constantValue(static_cast<const LiteralExpr*>(binary->right)));
+            } catch (const std::runtime_error&) {
+                // 例如"a" < 1：不折叠，留到执行到这里时再报错
+                return binary;
+            }
+            if (ExprNode* literal = makeLiteral(result)) {
+                // 折叠结果沿用原表达式的位置
+                literal->line = binary->line;
+                literal->col = binary->col;
+                return literal;
+            }
+        }
+    } else if (auto list = nodeCast<ListExpr>(expr)) {
+        for (auto& elem : list->elements) {
+            elem = fold(elem);
+        }
+    } else if (auto index = nodeCast<IndexExpr>(expr)) {
+        index->array = fold(index->array);
+        index->index = fold(index->index);
+    } else if (auto slice = nodeCast<SliceExpr>(expr)) {
+        slice->array = fold(slice->array);
+        if (slice->start) slice->start = fold(slice->start);
+        if (slice->stop) slice->stop = fold(slice->stop);
+    } else if (auto call = nodeCast<CallExpr>(expr)) {
+        for (auto& arg : call->arguments) {
+            arg = fold(arg);
+        }
+    } else if (auto methodCall = nodeCast<MethodCallExpr>(expr)) {
+        methodCall->object = fold(methodCall->object);
+        for (auto& arg : methodCall->arguments) {
+            arg = fold(arg);
+        }
+    } else if (auto fstring = nodeCast<FStringExpr>(expr)) {
+        for (size_t i = 0; i < fstring->segment_count; i++) {
+            if (fstring->segments[i].expr) {
+                fstring->segments[i].expr = fold(fstring->segments[i].expr);
+            }
+        }
+    }
+    return expr;
+}
+
+void Optimizer::optimizeStatement(StmtNode* stmt) {
+    if (auto printStmt = nodeCast<PrintStmt>(stmt)) {
+        for (auto& expr : printStmt->expressions) {
+            expr = fold(expr);
+        }
+    } else if (auto assignStmt = nodeCast<AssignStmt>(stmt)) {
+        assignStmt->value = fold(assignStmt->value);
+    } else if (auto withStmt = nodeCast<WithStmt>(stmt)) {
+        withStmt->context_expr = fold(withStmt->context_expr);
+        for (const auto& bodyStmt : withStmt->body) {
+            optimizeStatement(bodyStmt);
+        }
+    } else if (auto exprStmt = nodeCast<ExprStmt>(stmt)) {
+        exprStmt->expression = fold(exprStmt->expression);
+    }
+}
+
+void Optimizer::optimize(const StmtList& statements) {
+    for (const auto& stmt : statements) {
+        optimizeStatement(stmt);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "parser.h"
+#include "value.h"
+
+// 优化器：执行前对AST做常量折叠（2*3+1、"a"+"b"等）
+// 折叠产生的新字面量节点分配在编译单元的Arena中
+class Optimizer {
+private:
+    Arena& arena;
+
+    ExprNode* makeLiteral(const Value& value);
+    void optimizeStatement(StmtNode* stmt);
+
+public:
+    explicit Optimizer(Arena& nodeArena);
+    void optimize(const StmtList& statements);
+    // 折叠表达式，返回替换后的节点
+    ExprNode* fold(ExprNode* expr);
+};
+
+#endif
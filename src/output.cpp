@@ -0,0 +1,43 @@
+#include "output.h"
+#include "utils.h"
+#include <cstdio>
+
+OutputBuffer::OutputBuffer(std::FILE* target)
+    : stream(target), lineBuffered(target && Utils::isTerminal(target)), capture(nullptr) {
+    buffer.reserve(kCapacity + 256);
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+OutputBuffer& OutputBuffer::standardOutput() {
+    static OutputBuffer instance;
+    return instance;
+}
+
+void OutputBuffer::flush() {
+    CPPYTHON_STAT(output_flushes, 1);
+    CPPYTHON_STAT(output_bytes, buffer.size());
+    if (capture) {
+        capture->append(buffer);
+        buffer.clear();
+        return;
+    }
+    if (!stream) {
+        buffer.clear();
+        return;
+    }
+    if (!buffer.empty()) {
+        std::fwrite(buffer.data(), 1, buffer.size(), stream);
+        buffer.clear();
+    }
+    std::fflush(stream);
+}
+
+std::string* OutputBuffer::redirect(std::string* target) {
+    flush();
+    std::string* previous = capture;
+    capture = target;
+    return previous;
+}
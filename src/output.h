@@ -0,0 +1,61 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "value.h"
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// 输出缓冲区：print的输出先格式化进一块可复用的大缓冲区，
+// 满了、程序退出、读取输入之前或显式flush()时才真正写出。
+// 只有目标是终端时才按行刷新，重定向到文件或管道时整块写出。
+// 每个执行器可以有自己的缓冲区；standardOutput()是命令行共用的标准输出
+class OutputBuffer {
+private:
+    static constexpr size_t kCapacity = 64 * 1024;
+
+    std::string buffer;
+    std::FILE* stream;  // 为nullptr时输出被丢弃（除非设置了capture）
+    bool lineBuffered;
+    std::string* capture;  // 不为空时输出追加到这里而不是stream（嵌入使用）
+
+    void flushIfFull() {
+        if (buffer.size() >= kCapacity) flush();
+    }
+
+public:
+    explicit OutputBuffer(std::FILE* target = stdout);
+    ~OutputBuffer();
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    static OutputBuffer& standardOutput();
+
+    void write(std::string_view text) {
+        buffer.append(text.data(), text.size());
+        flushIfFull();
+    }
+
+    // 把值直接格式化进缓冲区，不产生临时字符串
+    void writeValue(const Value& value) {
+        value.appendTo(buffer);
+        flushIfFull();
+    }
+
+    // 结束一行：终端下立即刷新
+    void endLine() {
+        buffer += '\n';
+        if (lineBuffered) {
+            flush();
+        } else {
+            flushIfFull();
+        }
+    }
+
+    void flush();
+    // 把之后的输出改写到target（nullptr恢复为stream），返回原来的目标；切换前先刷新
+    std::string* redirect(std::string* target);
+};
+
+#endif
@@ -1,8 +1,16 @@
 #include "parser.h"
 #include <stdexcept>
 
-Parser::Parser(const std::vector<Token>& tokenList)
-    : tokens(tokenList), current(0) {}
+Parser::Parser(Lexer& tokenSource, Arena& nodeArena)
+    : lexer(tokenSource), lexed(0), current(0), arena(nodeArena) {}
+
+const Token& Parser::tokenAt(size_t index) {
+    while (lexed <= index) {
+        window[lexed % kWindow] = lexer.nextToken();
+        lexed++;
+    }
+    return window[index % kWindow];
+}
 
 bool Parser::match(TokenType type) {
     if (peek().type == type) {
@@ -21,70 +29,96 @@ Token Parser::consume(TokenType type, const std::string& message) {
     throw std::runtime_error(message + " at line " + std::to_string(peek().line));
 }
 
-bool Parser::isAtEnd() const {
+bool Parser::isAtEnd() {
     return peek().type == TokenType::EOF_TOKEN;
 }
 
-Token Parser::peek() const {
-    return tokens[current];
+const Token& Parser::peek() {
+    return tokenAt(current);
 }
 
-Token Parser::previous() const {
-    return tokens[current - 1];
+const Token& Parser::previous() const {
+    return window[(current - 1) % kWindow];
 }
 
-Token Parser::advance() {
+const Token& Parser::advance() {
     if (!isAtEnd()) current++;
     return previous();
 }
 
-std::unique_ptr<ExprNode> Parser::parseExpression() {
+// 字符串token按需解码：只有含转义符的才复制到Arena
+std::string_view Parser::stringText(const Token& token) {
+    if (!token.escaped) return token.value;
+    return arena.copyString(Lexer::processEscapeSequences(token.value));
+}
+
+// 记录节点的源码位置
+template<typename T>
+static T* located(T* node, int line, int col) {
+    node->line = line;
+    node->col = col;
+    return node;
+}
+
+template<typename T>
+static T* located(T* node, const Token& token) {
+    return located(node, token.line, token.col);
+}
+
+// 复合表达式的位置取它最左边的子表达式
+template<typename T>
+static T* located(T* node, const ASTNode* from) {
+    return located(node, from->line, from->col);
+}
+
+ExprNode* Parser::parseExpression() {
     return parseComparison();
 }
 
-std::unique_ptr<ExprNode> Parser::parseComparison() {
+ExprNode* Parser::parseComparison() {
     auto expr = parseTerm();
     
     while (match(TokenType::EQUAL) || match(TokenType::NOT_EQUAL) ||
            match(TokenType::LESS) || match(TokenType::GREATER)) {
         TokenType op = previous().type;
         auto right = parseTerm();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+        expr = located(arena.make<BinaryExpr>(expr, op, right), expr);
     }
     
     return expr;
 }
 
-std::unique_ptr<ExprNode> Parser::parseTerm() {
+ExprNode* Parser::parseTerm() {
     auto expr = parseFactor();
     
     while (match(TokenType::PLUS) || match(TokenType::MINUS)) {
         TokenType op = previous().type;
         auto right = parseFactor();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+        expr = located(arena.make<BinaryExpr>(expr, op, right), expr);
     }
     
     return expr;
 }
 
-std::unique_ptr<ExprNode> Parser::parseFactor() {
+ExprNode* Parser::parseFactor() {
     auto expr = parseUnary();
     
     while (match(TokenType::MULTIPLY) || match(TokenType::DIVIDE) || match(TokenType::MODULO)) {
         TokenType op = previous().type;
         auto right = parseUnary();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+        expr = located(arena.make<BinaryExpr>(expr, op, right), expr);
     }
     
     return expr;
 }
 
-std::unique_ptr<ExprNode> Parser::parseUnary() {
+ExprNode* Parser::parseUnary() {
     return parsePrimary();
 }
 
-std::unique_ptr<ExprNode> Parser::parseCall(std::unique_ptr<ExprNode> callee) {
-    std::vector<std::unique_ptr<ExprNode>> arguments;
+// 解析左括号之后的参数列表，包括右括号
+ExprList Parser::parseArguments() {
+    std::vector<ExprNode*> arguments;
     
     if (!match(TokenType::RPAREN)) {
         do {
@@ -94,14 +128,26 @@ std::unique_ptr<ExprNode> Parser::parseCall(std::unique_ptr<ExprNode> callee) {
         consume(TokenType::RPAREN, "Expected ')' after arguments");
     }
     
-    return std::make_unique<CallExpr>(std::move(callee), std::move(arguments));
+    return arena.makeList(arguments);
+}
+
+ExprNode* Parser::parseCall(ExprNode* callee) {
+    ExprList arguments = parseArguments();
+    
+    // 内置函数名在解析时查一次，执行时不再比较字符串
+    Builtin id = Builtin::NONE;
+    if (auto name = nodeCast<IdentifierExpr>(callee)) {
+        id = Builtins::lookup(name->name);
+    }
+    
+    return located(arena.make<CallExpr>(callee, arguments, id), callee);
 }
 
 // 添加列表解析
-std::unique_ptr<ExprNode> Parser::parseList() {
-    consume(TokenType::LBRACKET, "Expected '[' for list");
+ExprNode* Parser::parseList() {
+    Token start = consume(TokenType::LBRACKET, "Expected '[' for list");
     
-    std::vector<std::unique_ptr<ExprNode>> elements;
+    std::vector<ExprNode*> elements;
     
     if (!match(TokenType::RBRACKET)) {
         do {
@@ -111,37 +157,73 @@ std::unique_ptr<ExprNode> Parser::parseList() {
         consume(TokenType::RBRACKET, "Expected ']' after list elements");
     }
     
-    return std::make_unique<ListExpr>(std::move(elements));
+    return located(arena.make<ListExpr>(arena.makeList(elements)), start);
 }
 
 // 添加索引解析
-std::unique_ptr<ExprNode> Parser::parseIndex(std::unique_ptr<ExprNode> array) {
+ExprNode* Parser::parseIndex(ExprNode* array) {
     consume(TokenType::LBRACKET, "Expected '[' for index");
-    auto index = parseExpression();
-    consume(TokenType::RBRACKET, "Expected ']' after index");
+    ExprNode* index = nullptr;
+    if (peek().type != TokenType::COLON) {
+        index = parseExpression();
+    }
     
-    return std::make_unique<IndexExpr>(std::move(array), std::move(index));
+    // 切片：[start:stop]，两个边界都可以省略
+    if (match(TokenType::COLON)) {
+        ExprNode* stop = nullptr;
+        if (peek().type != TokenType::RBRACKET) {
+            stop = parseExpression();
+        }
+        consume(TokenType::RBRACKET, "Expected ']' after slice");
+        return located(arena.make<SliceExpr>(array, index, stop), array);
+    }
+    
+    consume(TokenType::RBRACKET, "Expected ']' after index");
+    return located(arena.make<IndexExpr>(array, index), array);
+}
+
+// 检查是否是函数调用、方法调用或索引，例如 open(name).read()；
+// callable为false时不接受直接调用，调用的结果也不能再被调用
+ExprNode* Parser::parseTrailers(ExprNode* base_expr, bool callable) {
+    while (true) {
+        if (callable && match(TokenType::LPAREN)) {
+            base_expr = parseCall(base_expr);
+            callable = false;
+        } else if (match(TokenType::DOT)) {
+            std::string_view method = consume(TokenType::IDENTIFIER, "Expected method name after '.'").value;
+            consume(TokenType::LPAREN, "Expected '(' after method name");
+            base_expr = located(arena.make<MethodCallExpr>(base_expr, method, parseArguments()), base_expr);
+        } else if (match(TokenType::LBRACKET)) {
+            current--; // 回退，让parseIndex处理
+            base_expr = parseIndex(base_expr);
+        } else {
+            break;
+        }
+    }
+    return base_expr;
 }
 
-std::unique_ptr<ExprNode> Parser::parsePrimary() {
+ExprNode* Parser::parsePrimary() {
     if (match(TokenType::NUMBER)) {
-        return std::make_unique<LiteralExpr>(previous().value, TokenType::NUMBER);
+        return located(arena.make<LiteralExpr>(previous().value, TokenType::NUMBER), previous());
     }
     
     if (match(TokenType::STRING)) {
-        return std::make_unique<LiteralExpr>(previous().value, TokenType::STRING);
+        // 字符串字面量后面可以接方法调用或下标，例如 "".join(parts)
+        ExprNode* literal = located(arena.make<LiteralExpr>(stringText(previous()), TokenType::STRING), previous());
+        return parseTrailers(literal, false);
     }
     
     if (match(TokenType::F_STRING)) {
-        return std::make_unique<FStringExpr>(previous().value);
+        return parseFString(previous());
     }
     
     if (match(TokenType::TRUE)) {
-        return std::make_unique<LiteralExpr>("True", TokenType::TRUE);
+        return located(arena.make<LiteralExpr>("True", TokenType::TRUE), previous());
     }
     
     if (match(TokenType::FALSE)) {
-        return std::make_unique<LiteralExpr>("False", TokenType::FALSE);
+        return located(arena.make<LiteralExpr>("False", TokenType::FALSE), previous());
     }
     
     // 添加列表字面量支持
@@ -151,23 +233,8 @@ std::unique_ptr<ExprNode> Parser::parsePrimary() {
     }
     
     if (match(TokenType::IDENTIFIER)) {
-        // 修复：使用正确的类型转换
-        auto expr = std::make_unique<IdentifierExpr>(previous().value);
-        std::unique_ptr<ExprNode> base_expr = std::move(expr); // 转换为基类指针
-        
-        // 检查是否是函数调用或索引
-        while (true) {
-            if (match(TokenType::LPAREN)) {
-                return parseCall(std::move(base_expr));
-            } else if (match(TokenType::LBRACKET)) {
-                current--; // 回退，让parseIndex处理
-                base_expr = parseIndex(std::move(base_expr));
-            } else {
-                break;
-            }
-        }
-        
-        return base_expr;
+        ExprNode* base_expr = located(arena.make<IdentifierExpr>(previous().value), previous());
+        return parseTrailers(base_expr, true);
     }
     
     if (match(TokenType::LPAREN)) {
@@ -179,15 +246,112 @@ std::unique_ptr<ExprNode> Parser::parsePrimary() {
     throw std::runtime_error("Expected expression at line " + std::to_string(peek().line));
 }
 
+// f-string里的转义：未知转义只保留被转义的字符
+static char decodeFStringEscape(char c) {
+    switch (c) {
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        default: return c;  // 包括 \\ \" \' \{ \}
+    }
+}
+
+// 用一个共享Arena的子解析器解析大括号里的表达式，不是完整表达式时返回nullptr
+ExprNode* Parser::parseFStringField(std::string_view text, int line, int col) {
+    try {
+        Lexer fieldLexer(text, line, col);
+        Parser fieldParser(fieldLexer, arena);
+        ExprNode* expr = fieldParser.parseExpression();
+        return fieldParser.isAtEnd() ? expr : nullptr;
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+// 把f-string模板编译成片段列表：相邻字面文本合并，表达式用正常的解析器解析
+ExprNode* Parser::parseFString(const Token& token) {
+    std::string_view tmpl = token.value;
+    // 模板紧跟在f和引号之后，且不会跨行
+    int tmplCol = token.col + 2;
+    std::vector<FStringSegment> segments;
+    std::string literal;
+    size_t literal_length = 0;
+    
+    auto flushLiteral = [&]() {
+        if (literal.empty()) return;
+        segments.push_back({arena.copyString(literal), nullptr});
+        literal_length += literal.size();
+        literal.clear();
+    };
+    
+    size_t pos = 0;
+    while (pos < tmpl.length()) {
+        if (tmpl[pos] == '\\') {
+            // 处理转义字符
+            if (pos + 1 < tmpl.length()) {
+                pos++;
+                literal += decodeFStringEscape(tmpl[pos]);
+            } else {
+                literal += tmpl[pos];
+            }
+            pos++;
+        } else if (tmpl[pos] == '{') {
+            // 找到匹配的右括号
+            size_t expr_start = pos + 1;
+            int brace_count = 1;
+            size_t expr_end = expr_start;
+            while (expr_end < tmpl.length() && brace_count > 0) {
+                if (tmpl[expr_end] == '{') {
+                    brace_count++;
+                } else if (tmpl[expr_end] == '}') {
+                    brace_count--;
+                }
+                if (brace_count > 0) expr_end++;
+            }
+            
+            if (brace_count > 0) {
+                literal += tmpl[pos];
+                pos++;
+                continue;
+            }
+            
+            std::string_view text = tmpl.substr(expr_start, expr_end - expr_start);
+            if (text.find_first_not_of(" \t") == std::string_view::npos) {
+                // 空的大括号显示为None
+                literal += "None";
+            } else if (ExprNode* expr = parseFStringField(text, token.line, tmplCol + (int)expr_start)) {
+                flushLiteral();
+                segments.push_back({text, expr});
+            } else {
+                // 无法解析的表达式原样保留
+                literal += '{';
+                literal += text;
+                literal += '}';
+            }
+            pos = expr_end + 1;
+        } else {
+            literal += tmpl[pos];
+            pos++;
+        }
+    }
+    flushLiteral();
+    
+    return located(arena.make<FStringExpr>(tmpl, arena.copyArray(segments), segments.size(), literal_length),
+                   token);
+}
+
 // 添加with语句解析
-std::unique_ptr<StmtNode> Parser::parseWithStatement() {
-    consume(TokenType::WITH, "Expected 'with'");
+StmtNode* Parser::parseWithStatement() {
+    Token start = consume(TokenType::WITH, "Expected 'with'");
     
     // 解析上下文表达式
     auto context_expr = parseExpression();
     
     // 可选的as子句
-    std::string optional_vars = "";
+    std::string_view optional_vars;
     if (match(TokenType::AS)) {
         Token var_token = consume(TokenType::IDENTIFIER, "Expected identifier after 'as'");
         optional_vars = var_token.value;
@@ -197,7 +361,7 @@ std::unique_ptr<StmtNode> Parser::parseWithStatement() {
     consume(TokenType::NEWLINE, "Expected newline after with statement");
     
     // 解析with语句体（简化处理）
-    std::vector<std::unique_ptr<StmtNode>> body;
+    std::vector<StmtNode*> body;
     while (!isAtEnd() && peek().type != TokenType::NEWLINE && peek().type != TokenType::EOF_TOKEN) {
         body.push_back(parseStatement());
         if (peek().type == TokenType::NEWLINE) {
@@ -205,10 +369,10 @@ std::unique_ptr<StmtNode> Parser::parseWithStatement() {
         }
     }
     
-    return std::make_unique<WithStmt>(std::move(context_expr), optional_vars, std::move(body));
+    return located(arena.make<WithStmt>(context_expr, optional_vars, arena.makeList(body)), start);
 }
 
-std::unique_ptr<StmtNode> Parser::parseStatement() {
+StmtNode* Parser::parseStatement() {
     if (peek().type == TokenType::PRINT) {
         return parsePrintStatement();
     }
@@ -218,21 +382,20 @@ std::unique_ptr<StmtNode> Parser::parseStatement() {
     }
     
     if (peek().type == TokenType::IDENTIFIER && 
-        current + 1 < tokens.size() && 
-        tokens[current + 1].type == TokenType::ASSIGN) {
+        tokenAt(current + 1).type == TokenType::ASSIGN) {
         return parseAssignmentStatement();
     }
     
     // 表达式语句
     auto expr = parseExpression();
-    return std::make_unique<ExprStmt>(std::move(expr));
+    return located(arena.make<ExprStmt>(expr), expr);
 }
 
-std::unique_ptr<StmtNode> Parser::parsePrintStatement() {
-    consume(TokenType::PRINT, "Expected 'print'");
+StmtNode* Parser::parsePrintStatement() {
+    Token start = consume(TokenType::PRINT, "Expected 'print'");
     consume(TokenType::LPAREN, "Expected '(' after 'print'");
     
-    std::vector<std::unique_ptr<ExprNode>> expressions;
+    std::vector<ExprNode*> expressions;
     
     if (peek().type != TokenType::RPAREN) {
         expressions.push_back(parseExpression());
@@ -244,20 +407,20 @@ std::unique_ptr<StmtNode> Parser::parsePrintStatement() {
     
     consume(TokenType::RPAREN, "Expected ')' after print arguments");
     
-    return std::make_unique<PrintStmt>(std::move(expressions));
+    return located(arena.make<PrintStmt>(arena.makeList(expressions)), start);
 }
 
-std::unique_ptr<StmtNode> Parser::parseAssignmentStatement() {
+StmtNode* Parser::parseAssignmentStatement() {
     Token identifier = consume(TokenType::IDENTIFIER, "Expected identifier");
     consume(TokenType::ASSIGN, "Expected '=' after identifier");
     
     auto value = parseExpression();
     
-    return std::make_unique<AssignStmt>(identifier.value, std::move(value));
+    return located(arena.make<AssignStmt>(identifier.value, value), identifier);
 }
 
-std::vector<std::unique_ptr<StmtNode>> Parser::parse() {
-    std::vector<std::unique_ptr<StmtNode>> statements;
+StmtList Parser::parse() {
+    std::vector<StmtNode*> statements;
     
     while (!isAtEnd()) {
         if (peek().type == TokenType::NEWLINE) {
@@ -288,19 +451,50 @@ std::vector<std::unique_ptr<StmtNode>> Parser::parse() {
         }
     }
     
-    return statements;
+    return arena.makeList(statements);
+}
+
+void CompilationUnit::parse(std::string_view text) {
+    Lexer lexer(text);
+    Parser parser(lexer, arena);
+    statements = parser.parse();
+}
+
+ExprNode* CompilationUnit::parseExpression(std::string_view text) {
+    Lexer lexer(text);
+    Parser parser(lexer, arena);
+    return parser.parseExpressionPublic();
+}
+
+bool CompilationUnit::parseFile(const std::string& filename) {
+    if (!source.open(filename)) return false;
+    parse(source.view());
+    return true;
+}
+
+bool CompilationUnit::parseStandardInput() {
+    if (!source.openStandardInput()) return false;
+    parse(source.view());
+    return true;
+}
+
+LiteralExpr::LiteralExpr(std::string_view val, TokenType t)
+    : ExprNode(kKind), value(val), type(t), number(0.0), boolean(t == TokenType::TRUE), constant(nullptr) {
+    if (t == TokenType::NUMBER) {
+        Utils::parseNumber(val, number);
+    }
 }
 
 std::string LiteralExpr::toString() const {
-    return value;
+    return std::string(value);
 }
 
 std::string FStringExpr::toString() const {
-    return "f\"" + template_string + "\"";
+    return "f\"" + std::string(template_string) + "\"";
 }
 
 std::string IdentifierExpr::toString() const {
-    return name;
+    return std::string(name);
 }
 
 // 添加ListExpr的toString实现
@@ -319,6 +513,11 @@ std::string IndexExpr::toString() const {
     return array->toString() + "[" + index->toString() + "]";
 }
 
+std::string SliceExpr::toString() const {
+    return array->toString() + "[" + (start ? start->toString() : "") + ":" +
+           (stop ? stop->toString() : "") + "]";
+}
+
 std::string BinaryExpr::toString() const {
     std::string opStr;
     switch (op) {
@@ -346,6 +545,16 @@ std::string CallExpr::toString() const {
     return result;
 }
 
+std::string MethodCallExpr::toString() const {
+    std::string result = object->toString() + "." + std::string(method) + "(";
+    for (size_t i = 0; i < arguments.size(); i++) {
+        if (i > 0) result += ", ";
+        result += arguments[i]->toString();
+    }
+    result += ")";
+    return result;
+}
+
 std::string PrintStmt::toString() const {
     std::string result = "print(";
     for (size_t i = 0; i < expressions.size(); i++) {
@@ -357,7 +566,7 @@ std::string PrintStmt::toString() const {
 }
 
 std::string AssignStmt::toString() const {
-    return variable + " = " + value->toString();
+    return std::string(variable) + " = " + value->toString();
 }
 
 std::string ExprStmt::toString() const {
@@ -367,7 +576,7 @@ std::string ExprStmt::toString() const {
 std::string WithStmt::toString() const {
     std::string result = "with " + context_expr->toString();
     if (!optional_vars.empty()) {
-        result += " as " + optional_vars;
+        result += " as " + std::string(optional_vars);
     }
     result += ":";
     return result;
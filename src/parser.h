@@ -2,181 +2,341 @@
 #define PARSER_H
 
 #include "lexer.h"
+#include "arena.h"
+#include "builtins.h"
+#include "methods.h"
+#include "utils.h"
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
+class Value;
+
+// 节点种类：由各节点的构造函数填写。编译器、执行器、Resolver和常量折叠
+// 按它switch分派，不再对每个节点逐个试dynamic_cast
+enum class NodeKind : uint8_t {
+    LITERAL,
+    FSTRING,
+    IDENTIFIER,
+    LIST,
+    INDEX,
+    SLICE,
+    BINARY,
+    CALL,
+    METHOD_CALL,
+    PRINT,
+    ASSIGN,
+    EXPR_STMT,
+    WITH
+};
+
 // AST节点基类
+// 节点全部分配在编译单元的Arena中并整体释放，所以节点必须可平凡析构：
+// 文本用指向Arena的string_view，子节点用裸指针和NodeList
 class ASTNode {
 public:
-    virtual ~ASTNode() = default;
+    NodeKind kind;
+    // 节点在源码中的位置（第一个token的行号和列号），由解析器填写
+    int line = 0;
+    int col = 0;
+
     virtual std::string toString() const = 0;
+
+protected:
+    explicit ASTNode(NodeKind k) : kind(k) {}
+    ~ASTNode() = default;
 };
 
 // 表达式节点
 class ExprNode : public ASTNode {
-public:
-    virtual ~ExprNode() = default;
+protected:
+    explicit ExprNode(NodeKind k) : ASTNode(k) {}
+    ~ExprNode() = default;
 };
 
 // 语句节点
 class StmtNode : public ASTNode {
-public:
-    virtual ~StmtNode() = default;
+protected:
+    explicit StmtNode(NodeKind k) : ASTNode(k) {}
+    ~StmtNode() = default;
 };
 
+// 按种类做的向下转换：node是T时返回T*，否则返回nullptr（node可以为空）
+template<typename T, typename Node>
+T* nodeCast(Node* node) {
+    return node && node->kind == T::kKind ? static_cast<T*>(node) : nullptr;
+}
+
+using ExprList = NodeList<ExprNode>;
+using StmtList = NodeList<StmtNode>;
+
 // 字面量表达式
 class LiteralExpr : public ExprNode {
 public:
-    std::string value;
+    static constexpr NodeKind kKind = NodeKind::LITERAL;
+    std::string_view value;
     TokenType type;
-    
-    LiteralExpr(const std::string& val, TokenType t) : value(val), type(t) {}
+    // 解析时解码的值，执行时不再从文本转换
+    double number;   // NUMBER
+    bool boolean;    // TRUE/FALSE
+    // STRING：执行器字符串池里的值，由Resolver填写；为nullptr时每次求值新建字符串
+    const Value* constant;
+
+    LiteralExpr(std::string_view val, TokenType t);
+    LiteralExpr(double n, std::string_view text)
+        : ExprNode(kKind), value(text), type(TokenType::NUMBER), number(n), boolean(false), constant(nullptr) {}
     std::string toString() const override;
 };
 
-// f-string表达式
+// f-string的一段：字面文本，或者是一个嵌入的表达式
+struct FStringSegment {
+    std::string_view text;  // 字面段为解码后的文本，表达式段为大括号内的原始文本
+    ExprNode* expr;         // 字面段为nullptr
+};
+
+// f-string表达式：解析时就切成字面段和表达式子树，求值时只做拼接
 class FStringExpr : public ExprNode {
 public:
-    std::string template_string;
-    
-    FStringExpr(const std::string& tmpl) : template_string(tmpl) {}
+    static constexpr NodeKind kKind = NodeKind::FSTRING;
+    std::string_view template_string;
+    FStringSegment* segments;
+    size_t segment_count;
+    size_t literal_length;  // 字面段总长度，用于预分配结果
+
+    FStringExpr(std::string_view tmpl, FStringSegment* segs, size_t count, size_t literal_len)
+        : ExprNode(kKind), template_string(tmpl), segments(segs), segment_count(count), literal_length(literal_len) {}
     std::string toString() const override;
 };
 
 // 标识符表达式
 class IdentifierExpr : public ExprNode {
 public:
-    std::string name;
-    
-    IdentifierExpr(const std::string& n) : name(n) {}
+    static constexpr NodeKind kKind = NodeKind::IDENTIFIER;
+    std::string_view name;
+    int slot;  // 由Resolver分配的变量槽位
+
+    IdentifierExpr(std::string_view n) : ExprNode(kKind), name(n), slot(-1) {}
     std::string toString() const override;
 };
 
 // 列表表达式
 class ListExpr : public ExprNode {
 public:
-    std::vector<std::unique_ptr<ExprNode>> elements;
-    
-    ListExpr(std::vector<std::unique_ptr<ExprNode>> elems)
-        : elements(std::move(elems)) {}
+    static constexpr NodeKind kKind = NodeKind::LIST;
+    ExprList elements;
+
+    ListExpr(ExprList elems) : ExprNode(kKind), elements(elems) {}
     std::string toString() const override;
 };
 
 // 索引表达式
 class IndexExpr : public ExprNode {
 public:
-    std::unique_ptr<ExprNode> array;
-    std::unique_ptr<ExprNode> index;
-    
-    IndexExpr(std::unique_ptr<ExprNode> arr, std::unique_ptr<ExprNode> idx)
-        : array(std::move(arr)), index(std::move(idx)) {}
+    static constexpr NodeKind kKind = NodeKind::INDEX;
+    ExprNode* array;
+    ExprNode* index;
+    // 求值下标不会改写变量时由Resolver置位，容器可以按引用取
+    bool borrow;
+
+    IndexExpr(ExprNode* arr, ExprNode* idx) : ExprNode(kKind), array(arr), index(idx), borrow(false) {}
+    std::string toString() const override;
+};
+
+// 切片表达式：array[start:stop]，省略的边界为nullptr
+class SliceExpr : public ExprNode {
+public:
+    static constexpr NodeKind kKind = NodeKind::SLICE;
+    ExprNode* array;
+    ExprNode* start;
+    ExprNode* stop;
+    bool borrow;  // 同IndexExpr::borrow
+
+    SliceExpr(ExprNode* arr, ExprNode* s, ExprNode* e) : ExprNode(kKind), array(arr), start(s), stop(e), borrow(false) {}
     std::string toString() const override;
 };
 
 // 二元操作表达式
 class BinaryExpr : public ExprNode {
 public:
-    std::unique_ptr<ExprNode> left;
-    std::unique_ptr<ExprNode> right;
+    static constexpr NodeKind kKind = NodeKind::BINARY;
+    ExprNode* left;
+    ExprNode* right;
     TokenType op;
-    
-    BinaryExpr(std::unique_ptr<ExprNode> l, TokenType o, std::unique_ptr<ExprNode> r)
-        : left(std::move(l)), op(o), right(std::move(r)) {}
+    // 操作数是变量时的槽位，求值时直接在槽位上读、不复制（由Resolver设置，否则为-1）；
+    // 右边会调用函数时左边不借用
+    int left_slot;
+    int right_slot;
+    // 类型反馈：两边不都是数字的次数。到达kPolymorphic后这个运算点按多态处理，
+    // 不再先试数字快速路径
+    static constexpr uint8_t kPolymorphic = 8;
+    mutable uint8_t misses;
+
+    BinaryExpr(ExprNode* l, TokenType o, ExprNode* r)
+        : ExprNode(kKind), left(l), right(r), op(o), left_slot(-1), right_slot(-1), misses(0) {}
     std::string toString() const override;
 };
 
 // 函数调用表达式
 class CallExpr : public ExprNode {
 public:
-    std::unique_ptr<ExprNode> callee;
-    std::vector<std::unique_ptr<ExprNode>> arguments;
-    
-    CallExpr(std::unique_ptr<ExprNode> c, std::vector<std::unique_ptr<ExprNode>> args)
-        : callee(std::move(c)), arguments(std::move(args)) {}
+    static constexpr NodeKind kKind = NodeKind::CALL;
+    ExprNode* callee;
+    ExprList arguments;
+    Builtin builtin;  // 解析时确定的内置函数编号，不是内置函数时为NONE
+
+    CallExpr(ExprNode* c, ExprList args, Builtin id = Builtin::NONE)
+        : ExprNode(kKind), callee(c), arguments(args), builtin(id) {}
+    std::string toString() const override;
+};
+
+// 方法调用表达式：obj.method(args)
+class MethodCallExpr : public ExprNode {
+public:
+    static constexpr NodeKind kKind = NodeKind::METHOD_CALL;
+    ExprNode* object;
+    std::string_view method;
+    ExprList arguments;
+    mutable MethodCache cache;  // 执行时填写的内联缓存
+    bool borrow;  // 参数不会改写变量，接收者可以按引用求值（由Resolver设置）
+
+    MethodCallExpr(ExprNode* obj, std::string_view m, ExprList args)
+        : ExprNode(kKind), object(obj), method(m), arguments(args), borrow(false) {}
     std::string toString() const override;
 };
 
 // 打印语句
 class PrintStmt : public StmtNode {
 public:
-    std::vector<std::unique_ptr<ExprNode>> expressions;
-    
-    PrintStmt(std::vector<std::unique_ptr<ExprNode>> exprs)
-        : expressions(std::move(exprs)) {}
+    static constexpr NodeKind kKind = NodeKind::PRINT;
+    ExprList expressions;
+
+    PrintStmt(ExprList exprs) : StmtNode(kKind), expressions(exprs) {}
     std::string toString() const override;
 };
 
 // 赋值语句
 class AssignStmt : public StmtNode {
 public:
-    std::string variable;
-    std::unique_ptr<ExprNode> value;
-    
-    AssignStmt(const std::string& var, std::unique_ptr<ExprNode> val)
-        : variable(var), value(std::move(val)) {}
+    static constexpr NodeKind kKind = NodeKind::ASSIGN;
+    std::string_view variable;
+    ExprNode* value;
+    int slot;  // 由Resolver分配的变量槽位
+    // value是“同一个变量 + 表达式”且表达式不会改写变量（由Resolver设置），
+    // 变量是字符串时原地追加
+    bool append;
+
+    AssignStmt(std::string_view var, ExprNode* val) : StmtNode(kKind), variable(var), value(val), slot(-1), append(false) {}
     std::string toString() const override;
 };
 
 // 表达式语句
 class ExprStmt : public StmtNode {
 public:
-    std::unique_ptr<ExprNode> expression;
-    
-    ExprStmt(std::unique_ptr<ExprNode> expr)
-        : expression(std::move(expr)) {}
+    static constexpr NodeKind kKind = NodeKind::EXPR_STMT;
+    ExprNode* expression;
+
+    ExprStmt(ExprNode* expr) : StmtNode(kKind), expression(expr) {}
     std::string toString() const override;
 };
 
 // With语句
 class WithStmt : public StmtNode {
 public:
-    std::unique_ptr<ExprNode> context_expr;
-    std::string optional_vars;
-    std::vector<std::unique_ptr<StmtNode>> body;
-    
-    WithStmt(std::unique_ptr<ExprNode> ctx_expr, const std::string& opt_vars, 
-             std::vector<std::unique_ptr<StmtNode>> b)
-        : context_expr(std::move(ctx_expr)), optional_vars(opt_vars), body(std::move(b)) {}
+    static constexpr NodeKind kKind = NodeKind::WITH;
+    ExprNode* context_expr;
+    std::string_view optional_vars;
+    StmtList body;
+    int optional_slot;  // as变量的槽位，没有as子句时为-1
+
+    WithStmt(ExprNode* ctx_expr, std::string_view opt_vars, StmtList b)
+        : StmtNode(kKind), context_expr(ctx_expr), optional_vars(opt_vars), body(b), optional_slot(-1) {}
     std::string toString() const override;
 };
 
+// 编译单元：拥有一段源码的AST节点和解码后的文本
+// 标识符、数字和不含转义的字符串直接引用源码，所以源码要比编译单元活得久；
+// 从文件解析时由编译单元持有文件映射。销毁或release()时整块释放
+class CompilationUnit {
+public:
+    Arena arena;
+    StmtList statements;
+
+    // 词法分析并解析整段源码（不复制源码）
+    void parse(std::string_view source);
+    // 只解析一个表达式（eval使用），语法错误时抛出异常
+    ExprNode* parseExpression(std::string_view source);
+    // 映射文件并解析，文件无法打开时返回false
+    bool parseFile(const std::string& filename);
+    // 读入标准输入的全部内容并解析，读取失败时返回false
+    bool parseStandardInput();
+    void release() {
+        statements = StmtList();
+        arena.release();
+        source.close();
+    }
+    // 清空以便解析下一段源码，保留Arena的内存
+    void reset() {
+        statements = StmtList();
+        arena.reset();
+        source.close();
+    }
+
+private:
+    Utils::MappedFile source;
+};
+
+// 解析器直接从词法分析器流式取token，只保留一个很小的窗口，
+// 不会物化整个token数组
 class Parser {
 private:
-    std::vector<Token> tokens;
+    // 解析过程中最多回看前一个、前瞻后一个token
+    static constexpr size_t kWindow = 4;
+
+    Lexer& lexer;
+    Token window[kWindow];
+    size_t lexed;  // 已从词法分析器取出的token数
     size_t current;
-    
+    Arena& arena;
+
+    const Token& tokenAt(size_t index);
     bool match(TokenType type);
     Token consume(TokenType type, const std::string& message);
-    bool isAtEnd() const;
-    Token peek() const;
-    Token previous() const;
-    Token advance();
-    
+    bool isAtEnd();
+    const Token& peek();
+    const Token& previous() const;
+    const Token& advance();
+    std::string_view stringText(const Token& token);
+    ExprNode* parseFString(const Token& token);
+    ExprNode* parseFStringField(std::string_view text, int line, int col);
+
     // 解析表达式
-    std::unique_ptr<ExprNode> parseExpression();
-    std::unique_ptr<ExprNode> parseComparison();
-    std::unique_ptr<ExprNode> parseTerm();
-    std::unique_ptr<ExprNode> parseFactor();
-    std::unique_ptr<ExprNode> parseUnary();
-    std::unique_ptr<ExprNode> parsePrimary();
-    std::unique_ptr<ExprNode> parseCall(std::unique_ptr<ExprNode> callee);
-    std::unique_ptr<ExprNode> parseList();
-    std::unique_ptr<ExprNode> parseIndex(std::unique_ptr<ExprNode> array);
-    
+    ExprNode* parseExpression();
+    ExprNode* parseComparison();
+    ExprNode* parseTerm();
+    ExprNode* parseFactor();
+    ExprNode* parseUnary();
+    ExprNode* parsePrimary();
+    ExprList parseArguments();
+    ExprNode* parseCall(ExprNode* callee);
+    ExprNode* parseList();
+    ExprNode* parseIndex(ExprNode* array);
+    ExprNode* parseTrailers(ExprNode* base_expr, bool callable);
+
     // 解析语句
-    std::unique_ptr<StmtNode> parseStatement();
-    std::unique_ptr<StmtNode> parsePrintStatement();
-    std::unique_ptr<StmtNode> parseAssignmentStatement();
-    std::unique_ptr<StmtNode> parseWithStatement();
-    
-public:
-    Parser(const std::vector<Token>& tokenList);
-    std::vector<std::unique_ptr<StmtNode>> parse();
-    
+    StmtNode* parseStatement();
+    StmtNode* parsePrintStatement();
+    StmtNode* parseAssignmentStatement();
+    StmtNode* parseWithStatement();
+
+public:
+    Parser(Lexer& tokenSource, Arena& nodeArena);
+    StmtList parse();
+
     // 添加公共方法用于eval
-    std::unique_ptr<ExprNode> parseExpressionPublic() {
+    ExprNode* parseExpressionPublic() {
         return parseExpression();
     }
 };
 
-#endif
\ No newline at end of file
+#endif
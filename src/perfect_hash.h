@@ -0,0 +1,62 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 编译期生成的完美哈希表，用于关键字、内置函数名这类固定的小集合
+// 哈希只看长度、首字符和末字符；构造时在编译期搜索一个没有冲突的种子，
+// 查找只需要一次哈希和一次字符串比较
+template<typename V>
+struct KeyValue {
+    std::string_view key;
+    V value;
+};
+
+template<typename V, size_t TableSize>
+class PerfectHash {
+    static_assert((TableSize & (TableSize - 1)) == 0, "TableSize must be a power of two");
+
+private:
+    KeyValue<V> slots[TableSize];
+    bool used[TableSize];
+    uint32_t seed;
+
+    static constexpr size_t slotOf(std::string_view key, uint32_t s) {
+        uint32_t h = s ^ static_cast<uint32_t>(key.size());
+        h = h * 0x9E3779B1u + static_cast<unsigned char>(key[0]);
+        h = h * 0x9E3779B1u + static_cast<unsigned char>(key[key.size() - 1]);
+        return (h ^ (h >> 16)) & (TableSize - 1);
+    }
+
+public:
+    template<size_t N>
+    constexpr PerfectHash(const KeyValue<V> (&entries)[N]) : slots{}, used{}, seed(0) {
+        static_assert(N <= TableSize, "too many keys for the table");
+        // 找到第一个让所有键落在不同槽位的种子
+        for (uint32_t s = 1; seed == 0; s++) {
+            bool taken[TableSize] = {};
+            bool collision = false;
+            for (size_t i = 0; i < N && !collision; i++) {
+                size_t slot = slotOf(entries[i].key, s);
+                collision = taken[slot];
+                taken[slot] = true;
+            }
+            if (!collision) seed = s;
+        }
+        for (size_t i = 0; i < N; i++) {
+            size_t slot = slotOf(entries[i].key, seed);
+            slots[slot] = entries[i];
+            used[slot] = true;
+        }
+    }
+
+    constexpr V find(std::string_view key, V missing) const {
+        if (key.empty()) return missing;
+        size_t slot = slotOf(key, seed);
+        return (used[slot] && slots[slot].key == key) ? slots[slot].value : missing;
+    }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+Profiler::Profiler(std::string scriptName) : elapsedNs(0) {
+    Frame root;
+    root.source = std::move(scriptName);
+    root.path = root.source;
+    started = last = root.start = Clock::now();
+    frames.push_back(std::move(root));
+}
+
+double Profiler::nanoseconds(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::nano>(to - from).count();
+}
+
+void Profiler::charge(Clock::time_point now) {
+    double ns = nanoseconds(last, now);
+    last = now;
+    Frame& top = frames.back();
+    if (top.current) top.current->selfNs += ns;
+    stacks[top.path] += ns;
+}
+
+void Profiler::line(int line) {
+    Clock::time_point now = Clock::now();
+    charge(now);
+
+    Frame& frame = frames.back();
+    if (frame.current) frame.current->totalNs += nanoseconds(frame.start, now);
+    std::string label = frame.source + ":" + std::to_string(line);
+    frame.path = frames.size() > 1 ? frames[frames.size() - 2].path + ";" + label : label;
+    frame.current = &lines[label];
+    frame.current->count++;
+    frame.start = now;
+}
+
+void Profiler::enterCall(std::string_view name, bool method) {
+    Clock::time_point now = Clock::now();
+    charge(now);
+
+    std::string label = method ? "." + std::string(name) : std::string(name);
+    Frame call;
+    call.path = frames.back().path + ";" + label;
+    call.current = &builtins[label];
+    call.current->count++;
+    call.start = now;
+    frames.push_back(std::move(call));
+}
+
+void Profiler::exitCall() {
+    Clock::time_point now = Clock::now();
+    charge(now);
+    frames.back().current->totalNs += nanoseconds(frames.back().start, now);
+    frames.pop_back();
+}
+
+void Profiler::enterCode(const char* name) {
+    Clock::time_point now = Clock::now();
+    charge(now);
+
+    Frame code;
+    code.source = name;
+    code.path = frames.back().path + ";" + name;
+    code.start = now;
+    frames.push_back(std::move(code));
+}
+
+void Profiler::exitCode() {
+    Clock::time_point now = Clock::now();
+    charge(now);
+    Frame& frame = frames.back();
+    if (frame.current) frame.current->totalNs += nanoseconds(frame.start, now);
+    frames.pop_back();
+}
+
+void Profiler::finish() {
+    Clock::time_point now = Clock::now();
+    charge(now);
+    // 调用帧和代码帧都由RAII守卫弹出，异常结束时这里也只剩最外层
+    Frame& root = frames.back();
+    if (root.current) root.current->totalNs += nanoseconds(root.start, now);
+    root.current = nullptr;
+    elapsedNs = nanoseconds(started, now);
+}
+
+namespace {
+    using Row = std::pair<const std::string*, const Profiler::Stats*>;
+
+    std::vector<Row> sortedBySelf(const std::unordered_map<std::string, Profiler::Stats>& table) {
+        std::vector<Row> rows;
+        rows.reserve(table.size());
+        for (const auto& entry : table) {
+            rows.emplace_back(&entry.first, &entry.second);
+        }
+        std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+            return a.second->selfNs > b.second->selfNs;
+        });
+        return rows;
+    }
+
+    void printRow(std::ostream& out, const std::string& name, const Profiler::Stats& stats) {
+        char buffer[160];
+        std::snprintf(buffer, sizeof(buffer), "  %-24s %10llu %12.3f %12.3f %12.3f\n", name.c_str(),
+                      (unsigned long long)stats.count, stats.selfNs / 1e6, stats.totalNs / 1e6,
+                      stats.count ? stats.totalNs / stats.count / 1e3 : 0.0);
+        out << buffer;
+    }
+}
+
+void Profiler::report(std::ostream& out) const {
+    char header[160];
+    std::snprintf(header, sizeof(header), "  %-24s %10s %12s %12s %12s\n",
+                  "", "count", "self ms", "total ms", "per call us");
+
+    out << "Profile of " << frames.front().source << ": " << elapsedNs / 1e6 << " ms\n";
+    out << "\nLines:\n" << header;
+    for (const auto& row : sortedBySelf(lines)) {
+        printRow(out, *row.first, *row.second);
+    }
+    if (!builtins.empty()) {
+        out << "\nBuiltins:\n" << header;
+        for (const auto& row : sortedBySelf(builtins)) {
+            printRow(out, *row.first, *row.second);
+        }
+    }
+    out.flush();
+}
+
+bool Profiler::writeCollapsed(const std::string& filename) const {
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) return false;
+    for (const auto& entry : stacks) {
+        long long us = (long long)(entry.second / 1e3 + 0.5);
+        if (us > 0) {
+            std::fprintf(file, "%s %lld\n", entry.first.c_str(), us);
+        }
+    }
+    return std::fclose(file) == 0;
+}
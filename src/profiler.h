@@ -0,0 +1,95 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 插桩式性能分析器（--profile）
+// 执行引擎在每行语句开始、内置函数和方法调用前后、进入eval/exec代码时通知分析器；
+// 两次事件之间的时间记到当时所在的调用栈上。没有开启时执行器只持有一个空指针，
+// 虚拟机使用不带插桩的分发循环
+class Profiler {
+public:
+    struct Stats {
+        uint64_t count = 0;
+        double selfNs = 0;   // 不含内置函数调用和嵌套代码的时间
+        double totalNs = 0;  // 从开始到结束的全部时间
+    };
+
+    // 在作用域内记录一次内置函数（或方法、print语句）调用，profiler为空时什么也不做
+    class Call {
+    private:
+        Profiler* profiler;
+
+    public:
+        Call(Profiler* p, std::string_view name, bool method = false) : profiler(p) {
+            if (profiler) profiler->enterCall(name, method);
+        }
+        ~Call() {
+            if (profiler) profiler->exitCall();
+        }
+        Call(const Call&) = delete;
+        Call& operator=(const Call&) = delete;
+    };
+
+    // 在作用域内执行一段eval/exec代码，它的行号单独统计
+    class Code {
+    private:
+        Profiler* profiler;
+
+    public:
+        Code(Profiler* p, const char* name) : profiler(p) {
+            if (profiler) profiler->enterCode(name);
+        }
+        ~Code() {
+            if (profiler) profiler->exitCode();
+        }
+        Code(const Code&) = delete;
+        Code& operator=(const Code&) = delete;
+    };
+
+    explicit Profiler(std::string scriptName);
+
+    // 当前代码开始执行第line行
+    void line(int line);
+    void enterCall(std::string_view name, bool method);
+    void exitCall();
+    void enterCode(const char* name);
+    void exitCode();
+
+    // 结束计时；之后才能输出报告
+    void finish();
+    // 按自身耗时排序的行表和内置函数表
+    void report(std::ostream& out) const;
+    // flamegraph.pl可以直接读取的折叠栈格式，权重单位为微秒
+    bool writeCollapsed(const std::string& filename) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame {
+        std::string source;         // 代码帧：源文件名或<eval>/<exec>
+        std::string path;           // 从最外层到本帧的折叠栈
+        Stats* current = nullptr;   // 代码帧正在执行的行，或调用帧的内置函数
+        Clock::time_point start;    // 当前行或本次调用开始的时间
+    };
+
+    std::vector<Frame> frames;
+    std::unordered_map<std::string, Stats> lines;     // "文件:行号"
+    std::unordered_map<std::string, Stats> builtins;  // 内置函数名，方法名前加"."
+    std::unordered_map<std::string, double> stacks;   // 折叠栈 -> 自身耗时
+    Clock::time_point started;
+    Clock::time_point last;
+    double elapsedNs;
+
+    // 把上一个事件以来的时间记到栈顶
+    void charge(Clock::time_point now);
+    static double nanoseconds(Clock::time_point from, Clock::time_point to);
+};
+
+#endif
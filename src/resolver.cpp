@@ -0,0 +1,119 @@
+#include "resolver.h"
+#include "stringpool.h"
+
+uint32_t SymbolTable::intern(std::string_view name) {
+    auto it = index.find(name);
+    if (it != index.end()) {
+        return it->second;
+    }
+    uint32_t slot = (uint32_t)names.size();
+    names.emplace_back(name);
+    index.emplace(names.back(), slot);
+    return slot;
+}
+
+int SymbolTable::find(std::string_view name) const {
+    auto it = index.find(name);
+    if (it != index.end()) {
+        return (int)it->second;
+    }
+    return -1;
+}
+
+Resolver::Resolver(SymbolTable& table, StringPool* pool) : symbols(table), strings(pool) {}
+
+bool Resolver::resolveExpression(ExprNode* expr) {
+    bool calls = false;
+    if (auto literal = nodeCast<LiteralExpr>(expr)) {
+        if (strings && literal->type == TokenType::STRING) {
+            literal->constant = strings->intern(literal->value);
+        }
+    } else if (auto identifier = nodeCast<IdentifierExpr>(expr)) {
+        identifier->slot = (int)symbols.intern(identifier->name);
+    } else if (auto list = nodeCast<ListExpr>(expr)) {
+        for (const auto& elem : list->elements) {
+            calls |= resolveExpression(elem);
+        }
+    } else if (auto index = nodeCast<IndexExpr>(expr)) {
+        calls = resolveExpression(index->array);
+        bool indexCalls = resolveExpression(index->index);
+        index->borrow = !indexCalls;
+        calls |= indexCalls;
+    } else if (auto slice = nodeCast<SliceExpr>(expr)) {
+        calls = resolveExpression(slice->array);
+        bool boundCalls = false;
+        if (slice->start) boundCalls |= resolveExpression(slice->start);
+        if (slice->stop) boundCalls |= resolveExpression(slice->stop);
+        slice->borrow = !boundCalls;
+        calls |= boundCalls;
+    } else if (auto binary = nodeCast<BinaryExpr>(expr)) {
+        calls = resolveExpression(binary->left);
+        bool rightCalls = resolveExpression(binary->right);
+        auto left = nodeCast<IdentifierExpr>(binary->left);
+        auto right = nodeCast<IdentifierExpr>(binary->right);
+        binary->left_slot = left && !rightCalls ? left->slot : -1;
+        binary->right_slot = right ? right->slot : -1;
+        calls |= rightCalls;
+    } else if (auto call = nodeCast<CallExpr>(expr)) {
+        calls = resolveExpression(call->callee);
+        for (const auto& arg : call->arguments) {
+            calls |= resolveExpression(arg);
+        }
+        // 其他内置函数都不会碰变量
+        calls |= call->builtin == Builtin::NONE || call->builtin == Builtin::EVAL ||
+                 call->builtin == Builtin::EXEC;
+    } else if (auto methodCall = nodeCast<MethodCallExpr>(expr)) {
+        // 文件和字符串的方法都不会碰变量
+        calls = resolveExpression(methodCall->object);
+        bool argumentCalls = false;
+        for (const auto& arg : methodCall->arguments) {
+            argumentCalls |= resolveExpression(arg);
+        }
+        methodCall->borrow = !argumentCalls;
+        calls |= argumentCalls;
+    } else if (auto fstring = nodeCast<FStringExpr>(expr)) {
+        // 单独的变量名也分配槽位：执行时槽位还没有赋值才原样显示为{name}
+        for (size_t i = 0; i < fstring->segment_count; i++) {
+            if (ExprNode* segment = fstring->segments[i].expr) {
+                calls |= resolveExpression(segment);
+            }
+        }
+    }
+    return calls;
+}
+
+void Resolver::resolveStatement(StmtNode* stmt) {
+    if (auto printStmt = nodeCast<PrintStmt>(stmt)) {
+        for (const auto& expr : printStmt->expressions) {
+            resolveExpression(expr);
+        }
+    } else if (auto assignStmt = nodeCast<AssignStmt>(stmt)) {
+        bool rebinds = resolveExpression(assignStmt->value);
+        assignStmt->slot = (int)symbols.intern(assignStmt->variable);
+        // x = x + ...：右边不会改写x时可以在x上原地追加
+        auto binary = nodeCast<BinaryExpr>(assignStmt->value);
+        auto target = binary ? nodeCast<IdentifierExpr>(binary->left) : nullptr;
+        assignStmt->append = !rebinds && target && binary->op == TokenType::PLUS &&
+                             target->slot == assignStmt->slot;
+    } else if (auto withStmt = nodeCast<WithStmt>(stmt)) {
+        resolveExpression(withStmt->context_expr);
+        if (!withStmt->optional_vars.empty()) {
+            withStmt->optional_slot = (int)symbols.intern(withStmt->optional_vars);
+        }
+        for (const auto& bodyStmt : withStmt->body) {
+            resolveStatement(bodyStmt);
+        }
+    } else if (auto exprStmt = nodeCast<ExprStmt>(stmt)) {
+        resolveExpression(exprStmt->expression);
+    }
+}
+
+void Resolver::resolve(const StmtList& statements) {
+    for (const auto& stmt : statements) {
+        resolveStatement(stmt);
+    }
+}
+
+void Resolver::resolve(ExprNode* expr) {
+    resolveExpression(expr);
+}
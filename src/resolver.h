@@ -0,0 +1,46 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "parser.h"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class StringPool;
+
+// 变量名到槽位编号的映射，槽位即执行环境中连续Value数组的下标
+// 索引的键指向names里的字符串（deque扩容不移动元素），按名查找不分配内存
+class SymbolTable {
+private:
+    std::unordered_map<std::string_view, uint32_t> index;
+    std::deque<std::string> names;
+
+public:
+    // 返回name的槽位，不存在时分配新槽位
+    uint32_t intern(std::string_view name);
+    // 返回name的槽位，不存在时返回-1（eval/exec/f-string按名查找使用）
+    int find(std::string_view name) const;
+    const std::string& name(uint32_t slot) const { return names[slot]; }
+    size_t size() const { return names.size(); }
+};
+
+// 解析器：在执行前给每个IdentifierExpr/AssignStmt/WithStmt的名字分配槽位
+class Resolver {
+private:
+    SymbolTable& symbols;
+    StringPool* strings;  // 不为空时给字符串字面量填上驻留的值
+
+    void resolveStatement(StmtNode* stmt);
+    // 返回求值表达式是否可能改写变量（含eval/exec或未知函数的调用）
+    bool resolveExpression(ExprNode* expr);
+
+public:
+    explicit Resolver(SymbolTable& table, StringPool* pool = nullptr);
+    void resolve(const StmtList& statements);
+    void resolve(ExprNode* expr);
+};
+
+#endif
@@ -0,0 +1,13 @@
+#include "stats.h"
+
+thread_local Stats::Counters Stats::counters;
+
+const char* Stats::name(Counter counter) {
+    static const char* const names[] = {
+#define CPPYTHON_STAT_NAME(name) #name,
+        CPPYTHON_STAT_COUNTERS(CPPYTHON_STAT_NAME)
+#undef CPPYTHON_STAT_NAME
+    };
+    size_t index = static_cast<size_t>(counter);
+    return index < kCounterCount ? names[index] : "";
+}
@@ -0,0 +1,73 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 运行时计数器（--stats和stats()内置函数）
+// 每个线程一组计数器，递增只是一次普通的加法。默认只在调试构建中编译进来，
+// 发布构建（定义了NDEBUG）需要加-DCPPYTHON_STATS=1才会计数，否则CPPYTHON_STAT展开为空
+#ifndef CPPYTHON_STATS
+#ifdef NDEBUG
+#define CPPYTHON_STATS 0
+#else
+#define CPPYTHON_STATS 1
+#endif
+#endif
+
+#define CPPYTHON_STAT_COUNTERS(X)                                      \
+    X(value_copies)        /* Value拷贝构造和拷贝赋值 */               \
+    X(value_moves)         /* Value移动构造和移动赋值 */               \
+    X(string_allocs)       /* 新分配的字符串负载 */                    \
+    X(list_allocs)         /* 新分配的列表负载 */                      \
+    X(bytes_allocs)        /* 新分配的字节串负载 */                    \
+    X(copy_on_write)       /* 修改共享负载前的复制 */                  \
+    X(slot_loads)          /* 按槽位读取变量 */                        \
+    X(name_lookups)        /* 按名字查找变量（eval/exec/f-string） */  \
+    X(ast_dispatches)      /* AST执行器按节点种类分发的次数 */ \
+    X(vm_instructions)     /* 虚拟机执行的指令数 */                    \
+    X(vm_stack_allocs)     /* 虚拟机值栈的分配和扩容 */                \
+    X(argument_spills)     /* 参数太多、放不进定长数组的调用 */        \
+    X(method_cache_hits)   /* 方法调用命中调用点缓存 */                \
+    X(method_cache_misses) /* 方法调用重新解析（首次或接收者类型变化） */ \
+    X(binary_fast)         /* 两边都是数字、不经过类型分派的二元运算 */ \
+    X(binary_generic)      /* 按类型分派的二元运算（字符串、列表等） */ \
+    X(eval_compiles)       /* eval()的解析和编译（缓存未命中或失效） */ \
+    X(exec_compiles)       /* exec()的解析和编译（缓存未命中或失效） */ \
+    X(file_bytes_read)                                                 \
+    X(file_bytes_written)                                              \
+    X(async_reads)         /* 交给异步后端的读请求（含预读） */        \
+    X(async_writes)        /* 交给异步后端的写请求（后台写入） */      \
+    X(async_submits)       /* 成批交出请求的次数（io_uring_enter） */  \
+    X(output_bytes)        /* 写到标准输出的字节数 */                  \
+    X(output_flushes)
+
+namespace Stats {
+    enum class Counter : size_t {
+#define CPPYTHON_STAT_ENUM(name) name,
+        CPPYTHON_STAT_COUNTERS(CPPYTHON_STAT_ENUM)
+#undef CPPYTHON_STAT_ENUM
+        COUNT
+    };
+
+    constexpr size_t kCounterCount = static_cast<size_t>(Counter::COUNT);
+
+    struct Counters {
+        uint64_t values[kCounterCount] = {};
+    };
+
+    extern thread_local Counters counters;
+
+    constexpr bool enabled() { return CPPYTHON_STATS != 0; }
+    const char* name(Counter counter);
+    inline uint64_t get(Counter counter) { return counters.values[static_cast<size_t>(counter)]; }
+}
+
+#if CPPYTHON_STATS
+#define CPPYTHON_STAT(name, n) \
+    (::Stats::counters.values[static_cast<size_t>(::Stats::Counter::name)] += (n))
+#else
+#define CPPYTHON_STAT(name, n) ((void)0)
+#endif
+
+#endif
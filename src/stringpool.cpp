@@ -0,0 +1,13 @@
+#include "stringpool.h"
+
+const Value* StringPool::intern(std::string_view text) {
+    if (text.size() > kMaxLength) return nullptr;
+    auto it = entries.find(text);
+    if (it != entries.end()) {
+        return &it->second;
+    }
+    if (entries.size() >= kMaxEntries) return nullptr;
+    Value value(text);
+    std::string_view key = value.stringValue();
+    return &entries.emplace(key, std::move(value)).first->second;
+}
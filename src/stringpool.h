@@ -0,0 +1,27 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include "value.h"
+#include <cstddef>
+#include <string_view>
+#include <unordered_map>
+
+// 字符串驻留池：内容相同的短字符串共享同一个不可变的Value负载
+// 池自己持有一个引用，写时复制保证共享的负载不会被原地修改；
+// 键指向负载自己的字符数组，查找不分配内存
+class StringPool {
+public:
+    static constexpr size_t kMaxLength = 64;      // 更长的字符串不驻留
+    static constexpr size_t kMaxEntries = 65536;  // 池满后不再收新字符串
+
+    // 返回驻留的值；太长或池已满时返回nullptr
+    const Value* intern(std::string_view text);
+
+    size_t size() const { return entries.size(); }
+    void clear() { entries.clear(); }
+
+private:
+    std::unordered_map<std::string_view, Value> entries;
+};
+
+#endif
@@ -4,6 +4,28 @@
 #include <iostream>
 #include <cstdio>
 #include <algorithm>
+#include <iterator>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CPPYTHON_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 std::string Utils::trim(const std::string& str) {
     size_t first = str.find_first_not_of(" \t\r\n");
@@ -44,22 +66,283 @@ std::string Utils::toLower(const std::string& str) {
     return result;
 }
 
-std::string Utils::readFile(const std::string& filename) {
+bool Utils::MappedFile::map(int fd) {
+#ifdef CPPYTHON_HAVE_MMAP
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) return false;
+
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) return false;
+    // 源码从头到尾顺序扫描一遍
+    madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    data = static_cast<const char*>(addr);
+    length = static_cast<size_t>(st.st_size);
+    mapped = true;
+    return true;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+bool Utils::MappedFile::open(const std::string& filename) {
+    close();
+#ifdef CPPYTHON_HAVE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = map(fd);
+    ::close(fd);
+    if (ok) return true;
+#endif
+
+    // 无法映射（空文件、管道或不支持mmap的平台）时读入内存
     std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
+    if (!file.is_open()) return false;
+
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size > 0) {
+        fallback.resize(static_cast<size_t>(size));
+        file.seekg(0, std::ios::beg);
+        file.read(&fallback[0], size);
+        fallback.resize(static_cast<size_t>(file.gcount()));
+    } else {
+        // 不能定位的流，逐块读取
+        file.clear();
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    data = fallback.data();
+    length = fallback.size();
+    return true;
+}
+
+bool Utils::MappedFile::openStandardInput() {
+    close();
+#ifdef CPPYTHON_HAVE_MMAP
+    // 从文件重定向进来（cppython - < script.py）并且还没读过时直接映射
+    // 读完后把位置移到末尾，和读到底的管道一样，之后的input()读到EOF
+    if (lseek(STDIN_FILENO, 0, SEEK_CUR) == 0 && map(STDIN_FILENO)) {
+        lseek(STDIN_FILENO, 0, SEEK_END);
+        return true;
+    }
+#endif
+
+    // 管道或终端：用stdio逐块读到末尾，不经过iostream
+    size_t used = 0;
+    for (;;) {
+        fallback.resize(used + kChunkSize);
+        size_t count = std::fread(&fallback[used], 1, kChunkSize, stdin);
+        used += count;
+        if (count < kChunkSize) break;
+    }
+    fallback.resize(used);
+    if (std::ferror(stdin)) return false;
+    data = fallback.data();
+    length = fallback.size();
+    return true;
+}
+
+void Utils::MappedFile::close() {
+#ifdef CPPYTHON_HAVE_MMAP
+    if (mapped) {
+        munmap(const_cast<char*>(data), length);
+    }
+#endif
+    data = nullptr;
+    length = 0;
+    mapped = false;
+    fallback.clear();
+}
+
+std::string Utils::readFile(const std::string& filename) {
+    MappedFile file;
+    if (!file.open(filename)) {
         std::cerr << "Error: Could not open file " << filename << std::endl;
         return "";
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    return std::string(file.view());
+}
+
+namespace {
+    bool hasWildcard(std::string_view text) {
+        return text.find_first_of("*?[") != std::string_view::npos;
+    }
+
+    // 匹配pattern[i]开始的字符集合；返回集合之后的位置，不是合法集合时返回npos
+    size_t matchClass(std::string_view pattern, size_t i, char c, bool& matched) {
+        size_t j = i + 1;
+        bool negate = j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^');
+        if (negate) j++;
+        matched = false;
+        bool first = true;
+        while (j < pattern.size() && (first || pattern[j] != ']')) {
+            first = false;
+            char low = pattern[j];
+            char high = low;
+            if (j + 2 < pattern.size() && pattern[j + 1] == '-' && pattern[j + 2] != ']') {
+                high = pattern[j + 2];
+                j += 2;
+            }
+            if (low <= c && c <= high) matched = true;
+            j++;
+        }
+        if (j >= pattern.size()) return std::string_view::npos;
+        if (negate) matched = !matched;
+        return j + 1;
+    }
+}
+
+bool Utils::matchWildcard(std::string_view pattern, std::string_view name) {
+    // 遇到*时记下位置，后面失配时让*多吞一个字符再试，不会指数回溯
+    size_t p = 0, n = 0;
+    size_t starPattern = std::string_view::npos, starName = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            starPattern = p++;
+            starName = n;
+            continue;
+        }
+        if (p < pattern.size()) {
+            char c = pattern[p];
+            if (c == '?') {
+                p++;
+                n++;
+                continue;
+            }
+            if (c == '[') {
+                bool matched;
+                size_t after = matchClass(pattern, p, name[n], matched);
+                if (after != std::string_view::npos) {
+                    if (matched) {
+                        p = after;
+                        n++;
+                        continue;
+                    }
+                } else if (name[n] == '[') {
+                    // 没有闭合的[按普通字符处理
+                    p++;
+                    n++;
+                    continue;
+                }
+            } else if (c == name[n]) {
+                p++;
+                n++;
+                continue;
+            }
+        }
+        if (starPattern == std::string_view::npos) return false;
+        p = starPattern + 1;
+        n = ++starName;
+    }
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
+
+std::vector<std::string> Utils::expandGlob(const std::string& pattern) {
+    namespace fs = std::filesystem;
+#ifdef _WIN32
+    constexpr const char* kSeparators = "/\\";
+#else
+    constexpr const char* kSeparators = "/";
+#endif
+    // 逐级展开：prefixes是已经匹配上的目录（带结尾分隔符），只有含通配符的一级才列目录
+    std::vector<std::string> prefixes = {""};
+    std::error_code error;
+    size_t start = 0;
+    while (start <= pattern.size() && !prefixes.empty()) {
+        size_t end = pattern.find_first_of(kSeparators, start);
+        if (end == std::string::npos) end = pattern.size();
+        std::string_view part(pattern.data() + start, end - start);
+        bool last = end == pattern.size();
+        std::string separator = last ? "" : std::string(1, pattern[end]);
+
+        std::vector<std::string> matched;
+        for (const auto& prefix : prefixes) {
+            if (!hasWildcard(part)) {
+                matched.push_back(prefix + std::string(part) + separator);
+                continue;
+            }
+            fs::directory_iterator it(prefix.empty() ? fs::path(".") : fs::path(prefix), error);
+            for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+                std::string name = it->path().filename().string();
+                if (name[0] == '.' && part[0] != '.') continue;
+                if (!matchWildcard(part, name)) continue;
+                if (!last && !it->is_directory(error)) continue;
+                matched.push_back(prefix + name + separator);
+            }
+            error.clear();
+        }
+        prefixes = std::move(matched);
+        start = end + 1;
+    }
+
+    std::vector<std::string> files;
+    for (auto& path : prefixes) {
+        if (fs::is_regular_file(path, error)) files.push_back(std::move(path));
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+size_t Utils::formatNumber(double value, char* buffer) {
+    char* end = buffer + kMaxNumberLength;
+    std::to_chars_result result;
+    // long long能精确表示的整数值按整数输出
+    if (value == std::trunc(value) && std::fabs(value) < 9.2e18) {
+        // 负零转成整数会丢掉符号，按Python的写法输出-0.0
+        if (value == 0 && std::signbit(value)) {
+            std::memcpy(buffer, "-0.0", 4);
+            return 4;
+        }
+        result = std::to_chars(buffer, end, static_cast<long long>(value));
+    } else {
+        result = std::to_chars(buffer, end, value);
+    }
+    return static_cast<size_t>(result.ptr - buffer);
+}
+
+void Utils::appendNumber(std::string& out, double value) {
+    char buffer[kMaxNumberLength];
+    out.append(buffer, formatNumber(value, buffer));
+}
+
+bool Utils::parseNumber(std::string_view text, double& value) {
+    size_t pos = 0;
+    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+    // from_chars不接受正号
+    if (pos < text.size() && text[pos] == '+' &&
+        !(pos + 1 < text.size() && text[pos + 1] == '-')) {
+        pos++;
+    }
+    
+    const char* first = text.data() + pos;
+    const char* last = text.data() + text.size();
+    auto result = std::from_chars(first, last, value);
+    if (result.ec == std::errc::result_out_of_range) {
+        // 溢出时from_chars不写结果，交给strtod得到inf或0
+        value = std::strtod(std::string(first, result.ptr).c_str(), nullptr);
+        return true;
+    }
+    return result.ec == std::errc();
 }
 
 void Utils::enableFastIO() {
-    std::ios_base::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-    std::cout.tie(nullptr);
+    // 解除同步会给标准流换上新的缓冲区，只做一次
+    static std::once_flag once;
+    std::call_once(once, [] {
+        std::ios_base::sync_with_stdio(false);
+        std::cin.tie(nullptr);
+        std::cout.tie(nullptr);
+    });
+}
+
+bool Utils::isTerminal(std::FILE* file) {
+#ifdef _WIN32
+    return _isatty(_fileno(file)) != 0;
+#else
+    return isatty(fileno(file)) != 0;
+#endif
 }
 
 void Utils::throwError(const std::string& message, int line) {
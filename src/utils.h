@@ -1,16 +1,63 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstddef>
+#include <cstdio>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace Utils {
+    // 只读文件映射：POSIX下用mmap直接映射，其他平台退化为整体读入内存
+    // 词法分析器的token直接指向这块内存，所以映射要和编译单元活得一样久
+    class MappedFile {
+    private:
+        const char* data;
+        size_t length;
+        bool mapped;
+        std::string fallback;
+
+        static constexpr size_t kChunkSize = 64 * 1024;  // 不能映射时每次读入的大小
+        bool map(int fd);
+
+    public:
+        MappedFile() : data(nullptr), length(0), mapped(false) {}
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& filename);
+        // 读入标准输入的全部内容：重定向自普通文件时映射，管道逐块读到末尾
+        bool openStandardInput();
+        void close();
+        std::string_view view() const { return std::string_view(data, length); }
+        size_t size() const { return length; }
+    };
+
+
     std::string trim(const std::string& str);
     std::vector<std::string> split(const std::string& str, char delimiter);
     bool isNumber(const std::string& str);
     std::string toLower(const std::string& str);
     std::string readFile(const std::string& filename);
+    // 通配符匹配：*匹配任意多个字符，?匹配一个字符，[abc]/[a-z]/[!abc]匹配字符集合
+    bool matchWildcard(std::string_view pattern, std::string_view name);
+    // 展开文件名模式（每一级目录都可以含通配符），只返回普通文件，按路径排序
+    // 以.开头的名字只有模式本身以.开头时才匹配；没有通配符时按原样返回存在的文件
+    std::vector<std::string> expandGlob(const std::string& pattern);
+
+    // 数字格式化和解析（基于to_chars/from_chars，不分配内存、不抛异常）
+    // 整数值不带小数点，其余输出能精确还原的最短形式
+    constexpr size_t kMaxNumberLength = 32;
+    size_t formatNumber(double value, char* buffer);  // buffer至少kMaxNumberLength字节
+    void appendNumber(std::string& out, double value);
+    // 跳过前导空白和正号后解析最长的数字前缀，没有数字时返回false
+    bool parseNumber(std::string_view text, double& value);
+    // 标准流不再和stdio同步；只在真正用std::cin读输入时调用（多次调用只生效一次）
     void enableFastIO();
+    // 文件（stdin/stdout）是否连着终端
+    bool isTerminal(std::FILE* file);
     void throwError(const std::string& message, int line = -1);
 }
 
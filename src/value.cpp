@@ -0,0 +1,506 @@
+#include "value.h"
+#include "utils.h"
+#include <iterator>
+#include <stdexcept>
+
+struct Value::StringObject : HeapObject {
+    std::string value;
+
+    explicit StringObject(const std::string& s) : value(s) { CPPYTHON_STAT(string_allocs, 1); }
+    explicit StringObject(std::string&& s) : value(std::move(s)) { CPPYTHON_STAT(string_allocs, 1); }
+};
+
+// 列表负载：只有storage对应的那个数组有内容。切片视图自己不存元素，
+// 元素是base的[offset, offset + length)，base总是一个非视图的列表
+struct Value::ListObject : HeapObject {
+    ListStorage storage;
+    List boxed;
+    std::vector<double> numbers;
+    std::vector<uint8_t> booleans;
+    Value base;
+    size_t offset = 0;
+    size_t length = 0;
+
+    explicit ListObject(ListStorage s) : storage(s) { CPPYTHON_STAT(list_allocs, 1); }
+
+    // 把全是数字或全是布尔值的元素收进紧凑数组
+    void pack(const Value* items, size_t count) {
+        if (storage == ListStorage::NUMBERS) {
+            numbers.resize(count);
+            for (size_t i = 0; i < count; i++) numbers[i] = items[i].number;
+        } else {
+            booleans.resize(count);
+            for (size_t i = 0; i < count; i++) booleans[i] = items[i].boolean;
+        }
+    }
+
+    bool isView() const { return base.type == Type::LIST; }
+    const ListObject& root() const { return isView() ? *static_cast<const ListObject*>(base.heap) : *this; }
+
+    size_t size() const {
+        if (isView()) return length;
+        switch (storage) {
+            case ListStorage::NUMBERS: return numbers.size();
+            case ListStorage::BOOLEANS: return booleans.size();
+            default: return boxed.size();
+        }
+    }
+
+    // 元素数组的起点，视图已经加上偏移
+    const double* numberData() const { return root().numbers.data() + offset; }
+    const uint8_t* booleanData() const { return root().booleans.data() + offset; }
+    const Value* boxedData() const { return root().boxed.data() + offset; }
+};
+
+namespace {
+    // 短于这个长度的切片直接复制，避免小切片让整个父列表一直存活
+    constexpr size_t kMinViewLength = 16;
+
+    // 空列表和混合内容逐项存放
+    Value::ListStorage classify(const Value* items, size_t count) {
+        if (count == 0) return Value::ListStorage::BOXED;
+        Value::Type first = items[0].type;
+        if (first != Value::Type::NUMBER && first != Value::Type::BOOLEAN) {
+            return Value::ListStorage::BOXED;
+        }
+        for (size_t i = 1; i < count; i++) {
+            if (items[i].type != first) return Value::ListStorage::BOXED;
+        }
+        return first == Value::Type::NUMBER ? Value::ListStorage::NUMBERS : Value::ListStorage::BOOLEANS;
+    }
+
+    template<typename T>
+    void repeatInto(std::vector<T>& out, const T* items, size_t count, size_t times) {
+        out.reserve(count * times);
+        for (size_t i = 0; i < times; i++) {
+            out.insert(out.end(), items, items + count);
+        }
+    }
+}
+
+// 字节串负载：data/size指向owner持有的内存，切片共享同一个owner
+struct Value::BytesObject : HeapObject {
+    std::shared_ptr<const void> owner;
+    const char* data;
+    size_t size;
+
+    BytesObject(std::shared_ptr<const void> o, const char* d, size_t n)
+        : owner(std::move(o)), data(d), size(n) {
+        CPPYTHON_STAT(bytes_allocs, 1);
+    }
+};
+
+Value::Value(const std::string& s) : type(Type::STRING), heap(new StringObject(s)) {}
+
+Value::Value(std::string&& s) : type(Type::STRING), heap(new StringObject(std::move(s))) {}
+
+Value::Value(const char* s) : type(Type::STRING), heap(new StringObject(std::string(s))) {}
+
+Value::Value(std::string_view s) : type(Type::STRING), heap(new StringObject(std::string(s))) {}
+
+Value::Value(const List& list) : type(Type::LIST) {
+    auto obj = new ListObject(classify(list.data(), list.size()));
+    if (obj->storage == ListStorage::BOXED) {
+        obj->boxed = list;
+    } else {
+        obj->pack(list.data(), list.size());
+    }
+    heap = obj;
+}
+
+Value::Value(List&& list) : type(Type::LIST) {
+    auto obj = new ListObject(classify(list.data(), list.size()));
+    if (obj->storage == ListStorage::BOXED) {
+        obj->boxed = std::move(list);
+    } else {
+        obj->pack(list.data(), list.size());
+    }
+    heap = obj;
+}
+
+Value Value::listFrom(Value* items, size_t count) {
+    auto obj = new ListObject(classify(items, count));
+    if (obj->storage == ListStorage::BOXED) {
+        obj->boxed.assign(std::make_move_iterator(items), std::make_move_iterator(items + count));
+    } else {
+        obj->pack(items, count);
+    }
+    Value result;
+    result.type = Type::LIST;
+    result.heap = obj;
+    return result;
+}
+
+Value Value::numberList(std::vector<double> numbers) {
+    auto obj = new ListObject(numbers.empty() ? ListStorage::BOXED : ListStorage::NUMBERS);
+    obj->numbers = std::move(numbers);
+    Value result;
+    result.type = Type::LIST;
+    result.heap = obj;
+    return result;
+}
+
+Value Value::booleanList(std::vector<uint8_t> booleans) {
+    auto obj = new ListObject(booleans.empty() ? ListStorage::BOXED : ListStorage::BOOLEANS);
+    obj->booleans = std::move(booleans);
+    Value result;
+    result.type = Type::LIST;
+    result.heap = obj;
+    return result;
+}
+
+Value Value::bytes(std::string data) {
+    auto storage = std::make_shared<const std::string>(std::move(data));
+    const char* begin = storage->data();
+    size_t size = storage->size();
+    return bytes(std::move(storage), begin, size);
+}
+
+Value Value::bytes(std::shared_ptr<const void> owner, const char* data, size_t size) {
+    Value result;
+    result.type = Type::BYTES;
+    result.heap = new BytesObject(std::move(owner), data, size);
+    return result;
+}
+
+std::string_view Value::bytesValue() const {
+    auto obj = static_cast<const BytesObject*>(heap);
+    return std::string_view(obj->data, obj->size);
+}
+
+Value Value::bytesSlice(size_t start, size_t length) const {
+    auto obj = static_cast<const BytesObject*>(heap);
+    return bytes(obj->owner, obj->data + start, length);
+}
+
+void Value::destroy() {
+    switch (type) {
+        case Type::STRING:
+            delete static_cast<StringObject*>(heap);
+            break;
+        case Type::LIST:
+            delete static_cast<ListObject*>(heap);
+            break;
+        case Type::FILE_OBJECT:
+            delete static_cast<FileObject*>(heap);
+            break;
+        case Type::BYTES:
+            delete static_cast<BytesObject*>(heap);
+            break;
+        default:
+            break;
+    }
+    heap = nullptr;
+}
+
+Value Value::clone() const {
+    switch (type) {
+        case Type::STRING:
+            return Value(stringValue());
+        case Type::LIST: {
+            auto obj = static_cast<const ListObject*>(heap);
+            size_t count = obj->size();
+            if (obj->storage == ListStorage::NUMBERS) {
+                return numberList(std::vector<double>(obj->numberData(), obj->numberData() + count));
+            }
+            if (obj->storage == ListStorage::BOOLEANS) {
+                return booleanList(std::vector<uint8_t>(obj->booleanData(), obj->booleanData() + count));
+            }
+            const Value* items = obj->boxedData();
+            List copy;
+            copy.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                copy.push_back(items[i].clone());
+            }
+            return Value(std::move(copy));
+        }
+        case Type::BYTES:
+            return bytes(std::string(bytesValue()));
+        case Type::FILE_OBJECT:
+            // 文件对象没法复制，共享又会让两个线程同时改它的引用计数
+            throw std::runtime_error("Cannot pass file object '" + fileObject()->filename +
+                                     "' to another thread");
+        default:
+            return *this;
+    }
+}
+
+const std::string& Value::stringValue() const {
+    return static_cast<const StringObject*>(heap)->value;
+}
+
+Value::ListStorage Value::listStorage() const {
+    return static_cast<const ListObject*>(heap)->storage;
+}
+
+size_t Value::listSize() const {
+    return static_cast<const ListObject*>(heap)->size();
+}
+
+Value Value::listItem(size_t index) const {
+    auto obj = static_cast<const ListObject*>(heap);
+    switch (obj->storage) {
+        case ListStorage::NUMBERS: return Value(obj->numberData()[index]);
+        case ListStorage::BOOLEANS: return Value(obj->booleanData()[index] != 0);
+        default: return obj->boxedData()[index];
+    }
+}
+
+const Value* Value::listBorrow(size_t index) const {
+    auto obj = static_cast<const ListObject*>(heap);
+    return obj->storage == ListStorage::BOXED ? obj->boxedData() + index : nullptr;
+}
+
+const double* Value::listNumbers() const {
+    return static_cast<const ListObject*>(heap)->numberData();
+}
+
+const uint8_t* Value::listBooleans() const {
+    return static_cast<const ListObject*>(heap)->booleanData();
+}
+
+const Value* Value::listBoxed() const {
+    return static_cast<const ListObject*>(heap)->boxedData();
+}
+
+Value Value::listSlice(size_t first, size_t last) const {
+    auto obj = static_cast<const ListObject*>(heap);
+    size_t count = last - first;
+    if (count == obj->size()) {
+        return *this;  // 列表不可变，整个切片直接共享
+    }
+    if (count >= kMinViewLength) {
+        // 视图总是指向最底层的列表，视图的视图不会串成链
+        auto view = new ListObject(obj->storage);
+        view->base = obj->isView() ? obj->base : *this;
+        view->offset = obj->offset + first;
+        view->length = count;
+        Value result;
+        result.type = Type::LIST;
+        result.heap = view;
+        return result;
+    }
+    switch (obj->storage) {
+        case ListStorage::NUMBERS:
+            return numberList(std::vector<double>(obj->numberData() + first, obj->numberData() + last));
+        case ListStorage::BOOLEANS:
+            return booleanList(std::vector<uint8_t>(obj->booleanData() + first, obj->booleanData() + last));
+        default:
+            // 混合列表的切片可能只剩一种类型，重新选择存储
+            return Value(List(obj->boxedData() + first, obj->boxedData() + last));
+    }
+}
+
+Value Value::listConcat(const Value& other) const {
+    auto lhs = static_cast<const ListObject*>(heap);
+    auto rhs = static_cast<const ListObject*>(other.heap);
+    size_t left = lhs->size();
+    size_t right = rhs->size();
+    if (lhs->storage == rhs->storage && lhs->storage == ListStorage::NUMBERS) {
+        std::vector<double> result;
+        result.reserve(left + right);
+        result.insert(result.end(), lhs->numberData(), lhs->numberData() + left);
+        result.insert(result.end(), rhs->numberData(), rhs->numberData() + right);
+        return numberList(std::move(result));
+    }
+    if (lhs->storage == rhs->storage && lhs->storage == ListStorage::BOOLEANS) {
+        std::vector<uint8_t> result;
+        result.reserve(left + right);
+        result.insert(result.end(), lhs->booleanData(), lhs->booleanData() + left);
+        result.insert(result.end(), rhs->booleanData(), rhs->booleanData() + right);
+        return booleanList(std::move(result));
+    }
+    // 存储不同（包括空列表）时逐项合并，再按内容选择存储
+    List result;
+    result.reserve(left + right);
+    for (size_t i = 0; i < left; i++) result.push_back(listItem(i));
+    for (size_t i = 0; i < right; i++) result.push_back(other.listItem(i));
+    return Value(std::move(result));
+}
+
+Value Value::listRepeat(size_t times) const {
+    auto obj = static_cast<const ListObject*>(heap);
+    size_t count = obj->size();
+    switch (obj->storage) {
+        case ListStorage::NUMBERS: {
+            std::vector<double> result;
+            repeatInto(result, obj->numberData(), count, times);
+            return numberList(std::move(result));
+        }
+        case ListStorage::BOOLEANS: {
+            std::vector<uint8_t> result;
+            repeatInto(result, obj->booleanData(), count, times);
+            return booleanList(std::move(result));
+        }
+        default: {
+            List result;
+            repeatInto(result, obj->boxedData(), count, times);
+            return Value(std::move(result));
+        }
+    }
+}
+
+std::string& Value::mutableString() {
+    auto obj = static_cast<StringObject*>(heap);
+    if (obj->refcount > 1) {
+        obj->refcount--;
+        CPPYTHON_STAT(copy_on_write, 1);
+        obj = new StringObject(obj->value);
+        heap = obj;
+    }
+    return obj->value;
+}
+
+void Value::appendText(const Value& other) {
+    auto obj = static_cast<StringObject*>(heap);
+    if (obj->refcount > 1) {
+        // 新串一次分配到位，不先复制再扩容
+        std::string copy;
+        size_t extra = other.type == Type::STRING ? other.stringValue().size() : 16;
+        copy.reserve(obj->value.size() + extra);
+        copy += obj->value;
+        other.appendTo(copy);
+        obj->refcount--;
+        heap = new StringObject(std::move(copy));
+        return;
+    }
+    other.appendTo(obj->value);
+}
+
+Value::List& Value::mutableList() {
+    auto obj = static_cast<ListObject*>(heap);
+    if (obj->refcount == 1 && !obj->isView() && obj->storage == ListStorage::BOXED) {
+        return obj->boxed;
+    }
+    // 共享、视图或紧凑存储：换成一份独占的、逐项存放的列表
+    if (obj->refcount > 1) {
+        CPPYTHON_STAT(copy_on_write, 1);
+    }
+    auto copy = new ListObject(ListStorage::BOXED);
+    size_t count = obj->size();
+    copy->boxed.reserve(count);
+    for (size_t i = 0; i < count; i++) copy->boxed.push_back(listItem(i));
+    release();
+    heap = copy;
+    return copy->boxed;
+}
+
+std::string Value::toString() const {
+    if (type == Type::STRING) {
+        return stringValue();
+    }
+    std::string result;
+    appendTo(result);
+    return result;
+}
+
+void Value::appendTo(std::string& out) const {
+    switch (type) {
+        case Type::NUMBER:
+            Utils::appendNumber(out, number);
+            break;
+        case Type::STRING:
+            out += stringValue();
+            break;
+        case Type::BOOLEAN:
+            out += boolean ? "True" : "False";
+            break;
+        case Type::LIST:
+            {
+                out += '[';
+                auto obj = static_cast<const ListObject*>(heap);
+                size_t count = listSize();
+                for (size_t i = 0; i < count; i++) {
+                    if (i > 0) out += ", ";
+                    switch (obj->storage) {
+                        case ListStorage::NUMBERS: Utils::appendNumber(out, obj->numberData()[i]); break;
+                        case ListStorage::BOOLEANS: out += obj->booleanData()[i] ? "True" : "False"; break;
+                        default: obj->boxedData()[i].appendTo(out); break;
+                    }
+                }
+                out += ']';
+                break;
+            }
+        case Type::BYTES:
+            {
+                // 和Python一样显示为b'...'，不可打印的字节用\x转义
+                static const char hex[] = "0123456789abcdef";
+                std::string_view data = bytesValue();
+                out += "b'";
+                for (unsigned char c : data) {
+                    switch (c) {
+                        case '\n': out += "\\n"; break;
+                        case '\r': out += "\\r"; break;
+                        case '\t': out += "\\t"; break;
+                        case '\\': out += "\\\\"; break;
+                        case '\'': out += "\\'"; break;
+                        default:
+                            if (c >= 0x20 && c < 0x7f) {
+                                out += (char)c;
+                            } else {
+                                out += "\\x";
+                                out += hex[c >> 4];
+                                out += hex[c & 0xf];
+                            }
+                            break;
+                    }
+                }
+                out += '\'';
+                break;
+            }
+        case Type::FILE_OBJECT:
+            if (FileObject* file = fileObject()) {
+                out += "<file '";
+                out += file->filename;
+                out += "' mode '";
+                out += file->mode;
+                out += "'>";
+            } else {
+                out += "<closed file>";
+            }
+            break;
+        case Type::NONE:
+        default:
+            out += "None";
+            break;
+    }
+}
+
+double Value::toNumber() const {
+    switch (type) {
+        case Type::NUMBER:
+            return number;
+        case Type::STRING:
+            {
+                double value = 0.0;
+                return Utils::parseNumber(stringValue(), value) ? value : 0.0;
+            }
+        case Type::BOOLEAN:
+            return boolean ? 1.0 : 0.0;
+        case Type::LIST:
+            return (double)listSize();
+        case Type::NONE:
+        default:
+            return 0.0;
+    }
+}
+
+bool Value::toBoolean() const {
+    switch (type) {
+        case Type::NUMBER:
+            return number != 0.0;
+        case Type::STRING:
+            return !stringValue().empty();
+        case Type::BOOLEAN:
+            return boolean;
+        case Type::LIST:
+            return listSize() != 0;
+        case Type::BYTES:
+            return !bytesValue().empty();
+        case Type::FILE_OBJECT:
+            return fileObject() && fileObject()->is_open;
+        case Type::NONE:
+        default:
+            return false;
+    }
+}
\ No newline at end of file
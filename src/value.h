@@ -0,0 +1,250 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include "stats.h"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 值类型：16字节的标签值
+// 数字和布尔值直接存放在值内部；字符串、列表和文件对象放在带引用计数的
+// 共享堆对象中，拷贝只增加引用计数，修改前按需复制（写时复制）
+class Value {
+public:
+    enum class Type : uint8_t {
+        NUMBER,
+        STRING,
+        BOOLEAN,
+        NONE,
+        FILE_OBJECT,
+        LIST,  // 添加列表类型
+        BYTES,  // 只读字节串，可以直接指向文件映射
+        UNBOUND  // 变量槽位还没有绑定值（或已被with语句解除）：只出现在执行器的变量数组里
+    };
+
+    using List = std::vector<Value>;
+
+    // 列表的存储方式：全是数字时是连续的double数组，全是布尔值时每项一个字节，
+    // 混合内容（或含字符串等堆对象）时才逐项存放Value
+    enum class ListStorage : uint8_t {
+        BOXED,
+        NUMBERS,
+        BOOLEANS
+    };
+
+    // 堆对象公共头部：引用计数
+    struct HeapObject {
+        uint32_t refcount = 1;
+    };
+
+    // 文件对象支持（引用语义：拷贝共享同一个文件对象）
+    // 持有文件描述符和自己的缓冲区，读写都经过异步后端（asyncio.h）：
+    // 顺序读取时后台预读下一块，写入攒满一块后在后台落盘，只有真正用到数据、
+    // flush()或close()时才等待；管道等不能按位置读写的文件直接同步读写。
+    // 除非调用read()读到末尾，否则不会把整个文件读进内存
+    struct FileObject : HeapObject {
+        std::string filename;
+        std::string mode;
+        bool is_binary;
+        bool is_open;
+        bool readable;
+        bool writable;
+
+        FileObject(const std::string& fname, const std::string& m, bool binary);
+        ~FileObject();
+        FileObject(const FileObject&) = delete;
+        FileObject& operator=(const FileObject&) = delete;
+
+        bool open();
+        std::string read(long long size = -1);  // size小于0时读到文件末尾
+        Value readMapped();  // 二进制模式：把剩余内容映射为字节串
+        std::string readline();
+        List readlines();
+        size_t write(std::string_view data);  // 后台写入的错误在下一次写入、flush()或close()时报告
+        void flush();
+        void close();
+
+    private:
+        int fd;
+        bool seekable;  // 普通文件，可以按位置异步读写
+        bool writing;   // 当前是写方向；读写都允许时换方向前先收尾另一个方向
+        bool eof;
+        bool carriage;  // Windows文本模式：上一块末尾的\r，等下一块确认是不是\r\n
+        bool drained;   // 上一次读到的不满一块，多半已经到末尾，不再预读
+        // 读：data[cursor, limit)是已读入、还没消费的内容，它结束于文件偏移nextRead；
+        // 下一块正在ahead里异步读取（aheadTicket非0时）。缓冲区不初始化，两块轮换使用
+        std::unique_ptr<char[]> data;
+        size_t cursor;
+        size_t limit;
+        uint64_t nextRead;
+        std::unique_ptr<char[]> ahead;
+        uint64_t aheadTicket;
+        // 写：pending积累新写入的数据，从文件偏移writeOffset开始；
+        // 满一块后交给flight在后台写，同一时间只有一块在写
+        std::string pending;
+        uint64_t writeOffset;
+        std::string flight;
+        uint64_t flightOffset;
+        uint64_t flightTicket;
+
+        void checkOpen() const;
+        bool fill();  // 保证data里有未消费的内容，读到末尾时返回false
+        void startReadAhead();
+        void keepReading();  // 顺序读过了当前块的一半时在后台读下一块
+        void discardReads();
+        void startWrite();
+        void finishWrite();
+        void toReading();
+        void toWriting();
+        uint64_t readPosition() const { return nextRead - (limit - cursor); }
+    };
+
+    Type type;
+    union {
+        double number;
+        bool boolean;
+        HeapObject* heap;  // STRING/LIST/FILE_OBJECT的共享负载
+    };
+
+    // 默认构造函数
+    Value() : type(Type::NONE), heap(nullptr) {}
+
+    // 未绑定的变量槽位；读变量时按None处理，f-string中显示为{name}
+    static Value unbound() {
+        Value value;
+        value.type = Type::UNBOUND;
+        return value;
+    }
+    bool isBound() const { return type != Type::UNBOUND; }
+
+    // 数字构造函数
+    Value(double n) : type(Type::NUMBER), number(n) {}
+
+    // 字符串构造函数
+    Value(const std::string& s);
+    Value(std::string&& s);
+    Value(const char* s);
+    Value(std::string_view s);
+
+    // 布尔构造函数
+    Value(bool b) : type(Type::BOOLEAN), heap(nullptr) { boolean = b; }
+
+    // 列表构造函数：按内容选择紧凑存储
+    Value(const List& list);
+    Value(List&& list);
+    // 从items[0..count)移出元素构造列表（虚拟机BUILD_LIST使用），不经过临时vector
+    static Value listFrom(Value* items, size_t count);
+    static Value numberList(std::vector<double> numbers);
+    static Value booleanList(std::vector<uint8_t> booleans);
+
+    // 文件对象构造函数
+    Value(std::unique_ptr<FileObject> file_obj) : type(Type::FILE_OBJECT), heap(file_obj.release()) {}
+
+    // 字节串：拥有自己的数据，或者是owner（例如文件映射）里的一段只读视图
+    static Value bytes(std::string data);
+    static Value bytes(std::shared_ptr<const void> owner, const char* data, size_t size);
+
+    // 拷贝只共享负载；赋值运算符都经过这两个构造函数，计数只在这里做
+    Value(const Value& other) : type(other.type), heap(other.heap) {
+        CPPYTHON_STAT(value_copies, 1);
+        retain();
+    }
+
+    Value(Value&& other) noexcept : type(other.type), heap(other.heap) {
+        CPPYTHON_STAT(value_moves, 1);
+        other.type = Type::NONE;
+        other.heap = nullptr;
+    }
+
+    Value& operator=(const Value& other) {
+        if (this != &other) {
+            Value copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            Value moved(std::move(other));
+            swap(moved);
+        }
+        return *this;
+    }
+
+    ~Value() { release(); }
+
+    void swap(Value& other) noexcept {
+        std::swap(type, other.type);
+        std::swap(heap, other.heap);
+    }
+
+    // 负载访问（调用前需确认类型）
+    const std::string& stringValue() const;
+    FileObject* fileObject() const { return static_cast<FileObject*>(heap); }
+    std::string_view bytesValue() const;
+    // 同一块数据的子区间，不复制
+    Value bytesSlice(size_t start, size_t length) const;
+
+    // 列表访问（调用前需确认是LIST）；紧凑存储的元素按需装箱
+    ListStorage listStorage() const;
+    size_t listSize() const;
+    Value listItem(size_t index) const;
+    // 逐项存放时直接返回元素的地址，不复制；紧凑存储返回nullptr
+    const Value* listBorrow(size_t index) const;
+    // 元素数组，长度为listSize()
+    const double* listNumbers() const;    // 仅NUMBERS
+    const uint8_t* listBooleans() const;  // 仅BOOLEANS
+    const Value* listBoxed() const;       // 仅BOXED
+    // 较长的切片是共享父列表存储的视图，不复制元素
+    Value listSlice(size_t first, size_t last) const;
+    // 列表连接和重复：两边存储相同时直接整块复制
+    Value listConcat(const Value& other) const;
+    Value listRepeat(size_t times) const;
+
+    // 深拷贝：字符串、列表和字节串都得到自己的负载，不碰原值的引用计数，
+    // 用于把值交给另一个线程。文件对象（包括列表里的）不能跨线程，抛出std::runtime_error
+    Value clone() const;
+
+    // 修改前的写时复制：负载被共享时先复制一份
+    std::string& mutableString();
+    // 把other的文本追加到字符串末尾：负载独占时原地追加（摊还O(1)），
+    // 被共享时复制一份再追加
+    void appendText(const Value& other);
+    // 紧凑存储的列表会先展开成逐项存放
+    List& mutableList();
+
+    std::string toString() const;
+    // 把文本形式直接追加到out末尾，避免临时字符串
+    void appendTo(std::string& out) const;
+    double toNumber() const;
+    bool toBoolean() const;
+
+private:
+    struct StringObject;
+    struct ListObject;
+    struct BytesObject;
+
+    bool isHeap() const {
+        return type == Type::STRING || type == Type::LIST || type == Type::FILE_OBJECT ||
+               type == Type::BYTES;
+    }
+
+    void retain() {
+        if (isHeap()) heap->refcount++;
+    }
+
+    void release() {
+        if (isHeap() && --heap->refcount == 0) destroy();
+    }
+
+    void destroy();
+};
+
+static_assert(sizeof(Value) == 16, "Value should stay a 16-byte tagged value");
+
+#endif
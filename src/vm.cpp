@@ -0,0 +1,330 @@
+#include "vm.h"
+#include "output.h"
+#include "profiler.h"
+#include <stdexcept>
+
+// GCC/Clang支持标签地址（computed goto），分发时直接跳转，避免switch的边界检查
+#if defined(__GNUC__) || defined(__clang__)
+#define CPPYTHON_COMPUTED_GOTO 1
+#endif
+
+namespace {
+    // 从执行器借一个值栈：每层嵌套各用一个，用完清空后留给下次执行
+    // 外层vector扩容时内层vector整体移动，缓冲区的地址不变，所以只记数据指针
+    class StackLease {
+    public:
+        StackLease(std::vector<std::vector<Value>>& stacks, size_t& depth, size_t size)
+            : depth(depth), used(size) {
+            if (stacks.size() <= depth) stacks.emplace_back();
+            std::vector<Value>& stack = stacks[depth];
+            if (stack.size() < size) {
+                CPPYTHON_STAT(vm_stack_allocs, 1);
+                stack.resize(size);
+            }
+            items = stack.data();
+            depth++;
+        }
+
+        ~StackLease() {
+            // 放掉栈上残留的引用（异常退出时可能还有值）
+            for (size_t i = 0; i < used; i++) items[i] = Value();
+            depth--;
+        }
+
+        StackLease(const StackLease&) = delete;
+        StackLease& operator=(const StackLease&) = delete;
+
+        Value* data() { return items; }
+        Value& operator[](size_t i) { return items[i]; }
+
+    private:
+        Value* items;
+        size_t& depth;
+        size_t used;
+    };
+}
+
+VM::VM(Executor& exec) : executor(exec) {}
+
+Value VM::run(const CodeObject& code) {
+    return executor.profiler ? execute<true>(code) : execute<false>(code);
+}
+
+template<bool Profiling>
+Value VM::execute(const CodeObject& code) {
+    StackLease stack(executor.vmStacks, executor.vmDepth, code.maxStackDepth + 1);
+    Value* sp = stack.data();
+    const Instruction* ip = code.code.data();
+    const Instruction* inst = nullptr;
+    const Value* constants = code.constants.data();
+    if (code.methodCaches.size() < code.constants.size()) {
+        code.methodCaches.resize(code.constants.size());
+    }
+    MethodCache* methodCaches = code.methodCaches.data();
+    Value* slots = executor.frame.data();
+    const uint32_t* lines = code.lines.data();
+    uint32_t currentLine = 0;
+    int withDepth = 0;
+    std::vector<size_t> withContexts;  // 已进入的with语句的上下文对象在栈上的位置
+
+// 分析模式下，执行到另一行的指令时报告新行号
+#define TRACE_LINE() \
+    if (Profiling && lines[inst - code.code.data()] != currentLine) { \
+        currentLine = lines[inst - code.code.data()]; \
+        executor.profiler->line((int)currentLine); \
+    }
+
+#ifdef CPPYTHON_COMPUTED_GOTO
+    static void* const dispatchTable[] = {
+#define CPPYTHON_OPCODE_LABEL(name) &&op_##name,
+        CPPYTHON_OPCODES(CPPYTHON_OPCODE_LABEL)
+#undef CPPYTHON_OPCODE_LABEL
+    };
+#define TARGET(name) op_##name:
+#define DISPATCH() do { inst = ip++; CPPYTHON_STAT(vm_instructions, 1); TRACE_LINE(); goto *dispatchTable[(size_t)inst->op]; } while (0)
+#else
+#define TARGET(name) case OpCode::name:
+#define DISPATCH() break
+#endif
+
+// 注意：computed goto跳出作用域时不会调用局部对象的析构函数，
+// 所以每个指令里的局部Value都放在内层作用域中，离开后再DISPATCH()
+// 两边都是数字时直接算，数字不持有堆对象，栈顶也不用清理
+#define BINARY(tokenType) \
+    { \
+        sp--; \
+        if (sp[-1].type == Value::Type::NUMBER && sp->type == Value::Type::NUMBER) { \
+            sp[-1] = Executor::applyNumbers(tokenType, sp[-1].number, sp->number); \
+        } else { \
+            sp[-1] = Executor::applyBinary(tokenType, sp[-1], *sp); \
+            *sp = Value(); \
+        } \
+        DISPATCH(); \
+    }
+
+    try {
+#ifdef CPPYTHON_COMPUTED_GOTO
+        DISPATCH();
+#else
+        for (;;) {
+            inst = ip++;
+            CPPYTHON_STAT(vm_instructions, 1);
+            TRACE_LINE();
+            switch (inst->op) {
+#endif
+        TARGET(LOAD_CONST) {
+            *sp++ = constants[inst->a];
+            DISPATCH();
+        }
+        TARGET(LOAD_FAST) {
+            CPPYTHON_STAT(slot_loads, 1);
+            if (slots[inst->a].isBound()) {
+                *sp++ = slots[inst->a];
+            } else {
+                *sp++ = Value();  // 未赋值的变量读作None
+            }
+            DISPATCH();
+        }
+        TARGET(LOAD_FORMAT_FAST) {
+            CPPYTHON_STAT(slot_loads, 1);
+            if (slots[inst->a].isBound()) {
+                *sp++ = slots[inst->a];
+            } else {
+                *sp++ = Value("{" + executor.symbols.name(inst->a) + "}");
+            }
+            DISPATCH();
+        }
+        TARGET(STORE_FAST) {
+            slots[inst->a] = std::move(*--sp);
+            DISPATCH();
+        }
+        TARGET(INPLACE_ADD_FAST) {
+            sp--;
+            if (slots[inst->a].type == Value::Type::NUMBER && sp->type == Value::Type::NUMBER) {
+                slots[inst->a].number += sp->number;
+                CPPYTHON_STAT(binary_fast, 1);
+            } else if (slots[inst->a].type == Value::Type::STRING) {
+                slots[inst->a].appendText(*sp);
+            } else {
+                slots[inst->a] = Executor::applyBinary(TokenType::PLUS, slots[inst->a], *sp);
+            }
+            *sp = Value();
+            DISPATCH();
+        }
+        TARGET(POP_TOP) {
+            *--sp = Value();
+            DISPATCH();
+        }
+        TARGET(BUILD_LIST) {
+            size_t count = inst->a;
+            {
+                // 直接从栈上取元素，全是数字或布尔值时收进紧凑数组
+                Value list = Value::listFrom(sp - count, count);
+                while (count--) *--sp = Value();
+                *sp++ = std::move(list);
+            }
+            DISPATCH();
+        }
+        TARGET(BINARY_INDEX) {
+            sp--;
+            sp[-1] = Executor::applyIndex(sp[-1], *sp);
+            *sp = Value();
+            DISPATCH();
+        }
+        TARGET(INDEX_FAST) {
+            CPPYTHON_STAT(slot_loads, 1);
+            sp[-1] = Executor::applyIndex(slots[inst->a], sp[-1]);
+            DISPATCH();
+        }
+        TARGET(BINARY_SLICE) {
+            sp -= 2;
+            sp[-1] = Executor::applySlice(sp[-1], sp[0], sp[1]);
+            sp[0] = Value();
+            sp[1] = Value();
+            DISPATCH();
+        }
+        TARGET(BINARY_ADD) {
+            sp--;
+            // 左边是上一步的临时串时原地追加，a + b + c是线性的
+            if (sp[-1].type == Value::Type::NUMBER && sp->type == Value::Type::NUMBER) {
+                sp[-1].number += sp->number;
+                CPPYTHON_STAT(binary_fast, 1);
+            } else if (sp[-1].type == Value::Type::STRING) {
+                sp[-1].appendText(*sp);
+            } else {
+                sp[-1] = Executor::applyBinary(TokenType::PLUS, sp[-1], *sp);
+            }
+            *sp = Value();
+            DISPATCH();
+        }
+        TARGET(BINARY_SUB) BINARY(TokenType::MINUS)
+        TARGET(BINARY_MUL) BINARY(TokenType::MULTIPLY)
+        TARGET(BINARY_DIV) BINARY(TokenType::DIVIDE)
+        TARGET(BINARY_MOD) BINARY(TokenType::MODULO)
+        TARGET(BINARY_OP) BINARY((TokenType)inst->a)
+        TARGET(BINARY_CONST) {
+            // 右边是数字常量：不压栈，左边是数字时直接算
+            double right = constants[inst->a].number;
+            TokenType op = (TokenType)inst->b;
+            if (sp[-1].type == Value::Type::NUMBER) {
+                sp[-1] = Executor::applyNumbers(op, sp[-1].number, right);
+            } else if (op == TokenType::PLUS && sp[-1].type == Value::Type::STRING) {
+                sp[-1].appendText(constants[inst->a]);
+            } else {
+                sp[-1] = Executor::applyBinary(op, sp[-1], constants[inst->a]);
+            }
+            DISPATCH();
+        }
+        TARGET(BUILD_STRING) {
+            size_t count = inst->a;
+            {
+                Value result = Executor::buildString(sp - count, count);
+                while (count--) *--sp = Value();
+                *sp++ = std::move(result);
+            }
+            DISPATCH();
+        }
+        TARGET(CALL_BUILTIN) {
+            size_t argc = inst->b;
+            {
+                Value result = executor.callBuiltin((Builtin)inst->a, sp - argc, argc);
+                while (argc--) *--sp = Value();
+                *sp++ = std::move(result);
+            }
+            // eval/exec可能分配新槽位导致变量数组扩容
+            slots = executor.frame.data();
+            DISPATCH();
+        }
+        TARGET(CALL_METHOD) {
+            size_t argc = inst->b;
+            {
+                Value* self = sp - argc - 1;
+                Value result = executor.callMethod(*self, constants[inst->a].stringValue(),
+                                                   methodCaches[inst->a], self + 1, argc);
+                while (sp != self) *--sp = Value();
+                *sp++ = std::move(result);
+            }
+            DISPATCH();
+        }
+        TARGET(CALL_FAST) {
+            size_t argc = inst->b;
+            {
+                Value result = executor.callObject(inst->a, sp - argc, argc);
+                while (argc--) *--sp = Value();
+                *sp++ = std::move(result);
+            }
+            DISPATCH();
+        }
+        TARGET(PRINT) {
+            size_t count = inst->a;
+            {
+                Profiler::Call call(Profiling ? executor.profiler : nullptr, "print");
+                executor.printValues(sp - count, count, "");
+            }
+            while (count--) *--sp = Value();
+            DISPATCH();
+        }
+        TARGET(PRINT_EXPR) {
+            // 只在交互模式下输出表达式结果
+            sp--;
+            if (executor.interactiveMode && sp->type != Value::Type::NONE) {
+                executor.output->writeValue(*sp);
+                executor.output->endLine();
+            }
+            *sp = Value();
+            DISPATCH();
+        }
+        TARGET(SETUP_WITH) {
+            withDepth++;
+            DISPATCH();
+        }
+        TARGET(ENTER_WITH) {
+            // 上下文对象留在栈顶，直到EXIT_WITH
+            withContexts.push_back((size_t)(sp - 1 - stack.data()));
+            if (inst->b) {
+                slots[inst->a] = sp[-1];
+            }
+            DISPATCH();
+        }
+        TARGET(EXIT_WITH) {
+            Executor::exitContext(sp[-1]);
+            *--sp = Value();
+            withContexts.pop_back();
+            // 清理：如果使用了as子句，从变量中移除
+            if (inst->b) {
+                slots[inst->a] = Value::unbound();
+            }
+            withDepth--;
+            DISPATCH();
+        }
+        TARGET(RETURN_VALUE) {
+            return std::move(*--sp);
+        }
+        TARGET(HALT) {
+            return Value();
+        }
+#ifndef CPPYTHON_COMPUTED_GOTO
+            }
+        }
+#endif
+    } catch (const std::exception& e) {
+        // 异常离开with语句体时同样关闭上下文对象
+        for (size_t i = withContexts.size(); i-- > 0;) {
+            Executor::exitContext(stack[withContexts[i]]);
+        }
+        if (withDepth == 0) {
+            throw;
+        }
+        // 与AST执行器一致：每层with语句包装一次错误信息
+        std::string message = e.what();
+        for (int i = 0; i < withDepth; i++) {
+            message = "with statement error: " + message;
+        }
+        throw std::runtime_error(message);
+    }
+
+#undef BINARY
+#undef TRACE_LINE
+#undef DISPATCH
+#undef TARGET
+}
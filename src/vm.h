@@ -0,0 +1,22 @@
+#ifndef VM_H
+#define VM_H
+
+#include "compiler.h"
+#include "executor.h"
+
+// 字节码虚拟机：在Executor的变量环境中执行CodeObject
+class VM {
+private:
+    Executor& executor;
+
+    // Profiling为true时每行开始和每条print都通知分析器；false时分发循环里没有任何插桩
+    template<bool Profiling>
+    Value execute(const CodeObject& code);
+
+public:
+    explicit VM(Executor& exec);
+    // 执行代码对象，返回RETURN_VALUE的结果（语句序列返回None）
+    Value run(const CodeObject& code);
+};
+
+#endif
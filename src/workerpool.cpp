@@ -0,0 +1,141 @@
+#include "workerpool.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+WorkerPool::WorkerPool(size_t count)
+    : jobs(nullptr), results(nullptr), finished(nullptr), waitingFor(0), next(0), active(0), generation(0), stopping(false) {
+    if (count == 0) {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+std::vector<WorkerPool::Result> WorkerPool::run(const std::vector<Job>& batch) {
+    std::vector<Result> collected(batch.size());
+    run(batch, [&](size_t index, Result& result) { collected[index] = std::move(result); });
+    return collected;
+}
+
+void WorkerPool::run(const std::vector<Job>& batch, const Delivery& deliver) {
+    if (batch.empty()) return;
+    std::vector<Result> output(batch.size());
+    std::vector<uint8_t> ready(batch.size());
+
+    std::lock_guard<std::mutex> batchLock(batchMutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs = &batch;
+    results = &output;
+    finished = &ready;
+    waitingFor = 0;
+    next.store(0, std::memory_order_relaxed);
+    active = threads.size();
+    generation++;
+    wake.notify_all();
+
+    // deliver抛出异常时也要等工作线程停下，它们还在写这一批的结果
+    std::exception_ptr failure;
+    for (size_t i = 0; i < batch.size() && !failure; i++) {
+        waitingFor = i;
+        done.wait(lock, [&] { return ready[i] != 0; });
+        lock.unlock();
+        try {
+            deliver(i, output[i]);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        output[i] = Result();
+        lock.lock();
+    }
+    if (failure) {
+        // 剩下的任务不再领取
+        next.store(batch.size(), std::memory_order_relaxed);
+    }
+    done.wait(lock, [this] { return active == 0; });
+    jobs = nullptr;
+    results = nullptr;
+    finished = nullptr;
+    if (failure) std::rethrow_exception(failure);
+}
+
+void WorkerPool::workerLoop() {
+    // 解释器属于这个线程，批次之间保留，eval/exec缓存和槽位映射可以复用
+    EmbeddedInterpreter interpreter;
+    uint64_t seen = 0;
+
+    while (true) {
+        const std::vector<Job>* batch;
+        std::vector<Result>* out;
+        std::vector<uint8_t>* ready;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            batch = jobs;
+            out = results;
+            ready = finished;
+        }
+
+        // 按任务编号领取，耗时不均的任务也能摊到所有线程上
+        for (size_t i = next.fetch_add(1); i < batch->size(); i = next.fetch_add(1)) {
+            runJob(interpreter, (*batch)[i], (*out)[i]);
+            std::lock_guard<std::mutex> lock(mutex);
+            (*ready)[i] = 1;
+            if (i == waitingFor) done.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active == 0) done.notify_one();
+    }
+}
+
+void WorkerPool::runJob(EmbeddedInterpreter& interpreter, const Job& job, Result& result) {
+    std::istringstream text(job.input);
+    std::ifstream file;
+    interpreter.reset();
+    interpreter.setOutput(&result.output);
+    interpreter.setInput(&text);
+    try {
+        if (!job.inputFile.empty()) {
+            file.open(job.inputFile, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("Could not open input file " + job.inputFile);
+            }
+            interpreter.setInput(&file);
+        }
+        for (const auto& entry : job.inputs) {
+            interpreter.set(entry.first, entry.second.clone());
+        }
+        interpreter.run(job.script);
+        for (const auto& name : job.outputs) {
+            Value value;
+            if (interpreter.get(name, value)) {
+                result.values.emplace_back(name, value.clone());
+            }
+        }
+        result.ok = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    // 本任务的变量不带到下一个任务，也不留指向result的指针
+    interpreter.reset();
+    interpreter.setOutput(nullptr);
+    interpreter.setInput(nullptr);
+}
@@ -0,0 +1,87 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include "embed.h"
+#include "value.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 批量执行：一组常驻线程，每个线程有自己的EmbeddedInterpreter，
+// 同一批任务按顺序分给空闲的线程，结果按任务顺序返回
+//
+//     CompiledScript script = EmbeddedInterpreter::compile("y = x * 2\nprint(y)");
+//     std::vector<WorkerPool::Job> jobs(1000);
+//     for (size_t i = 0; i < jobs.size(); i++) {
+//         jobs[i].script = script;
+//         jobs[i].inputs = {{"x", Value((double)i)}};
+//         jobs[i].outputs = {"y"};
+//     }
+//     WorkerPool pool;
+//     std::vector<WorkerPool::Result> results = pool.run(jobs);
+//
+// 每个任务在一个清空过的环境里执行，任务之间不共享变量。输入值在工作线程上
+// 深拷贝，取回的值也是深拷贝，双方都不会碰到对方的引用计数；
+// 文件对象不能跨线程：作为输入或输出时这个任务失败（见Value::clone()）
+class WorkerPool {
+public:
+    struct Job {
+        CompiledScript script;
+        std::vector<std::pair<std::string, Value>> inputs;  // 执行前设置的变量
+        std::vector<std::string> outputs;  // 执行后取回的变量
+        std::string input;  // input()读取的内容
+        std::string inputFile;  // 非空时input()改为逐行读这个文件（在工作线程上打开）
+    };
+
+    struct Result {
+        bool ok = false;
+        std::string output;  // print的输出
+        std::string error;  // 执行失败时的错误信息
+        std::vector<std::pair<std::string, Value>> values;  // 取回的变量，不存在的变量不出现
+    };
+
+    // threads为0时使用硬件线程数
+    explicit WorkerPool(size_t threads = 0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const { return threads.size(); }
+
+    // 执行一批任务，全部完成后返回；可以从多个线程调用，各批依次执行
+    std::vector<Result> run(const std::vector<Job>& jobs);
+
+    // 同上，但结果按任务顺序在调用线程上逐个交给deliver：第i个任务一完成、
+    // 前面的都已交付就立即交付，不等整批结束，交付后的结果不再保留
+    using Delivery = std::function<void(size_t index, Result& result)>;
+    void run(const std::vector<Job>& jobs, const Delivery& deliver);
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex batchMutex;  // 同一时间只执行一批
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // 当前批次，由mutex保护
+    const std::vector<Job>* jobs;
+    std::vector<Result>* results;
+    std::vector<uint8_t>* finished;  // 每个任务是否已完成
+    size_t waitingFor;  // 调用线程正在等待的任务
+    std::atomic<size_t> next;
+    size_t active;
+    uint64_t generation;
+    bool stopping;
+
+    void workerLoop();
+    static void runJob(EmbeddedInterpreter& interpreter, const Job& job, Result& result);
+};
+
+#endif
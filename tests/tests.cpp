@@ -0,0 +1,319 @@
+// 回归测试：在两个执行引擎上运行小脚本，逐项比较输出
+// 每个用例失败时把期望和实际输出写到标准错误；全部通过时返回0
+//
+// 用法：tests [--filter 名字片段]
+#include "parser.h"
+#include "asyncio.h"
+#include "bytecache.h"
+#include "compiler.h"
+#include "embed.h"
+#include "executor.h"
+#include "interpreter.h"
+#include "output.h"
+#include "stats.h"
+#include "workerpool.h"
+#include "utils.h"
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    struct TestCase {
+        const char* name;
+        std::function<void()> body;
+    };
+
+    int failures = 0;
+
+    void expectEqual(const std::string& actual, const std::string& expected, const std::string& what) {
+        if (actual == expected) return;
+        failures++;
+        std::cerr << "  " << what << "\n    expected: \"" << expected << "\"\n    actual:   \"" << actual << "\"\n";
+    }
+
+    // 在新的执行器上运行源码，返回print的输出
+    std::string run(const std::string& source, Engine engine) {
+        OutputBuffer output(nullptr);
+        std::string captured;
+        output.redirect(&captured);
+        Executor executor(false);
+        executor.setOutput(&output);
+        executor.setEngine(engine);
+        CompilationUnit unit;
+        unit.parse(source);
+        executor.execute(unit);
+        output.flush();
+        return captured;
+    }
+
+    // 计数器counter在run(source, engine)期间增加了多少
+    uint64_t countDuring(const std::string& source, Engine engine, Stats::Counter counter) {
+        uint64_t before = Stats::get(counter);
+        run(source, engine);
+        return Stats::get(counter) - before;
+    }
+
+    void expectAtMost(uint64_t actual, uint64_t limit, const std::string& what) {
+        if (actual <= limit) return;
+        failures++;
+        std::cerr << "  " << what << "\n    limit:  " << limit << "\n    actual: " << actual << "\n";
+    }
+
+    // 两个引擎的输出都必须是expected
+    void expectOutput(const std::string& source, const std::string& expected) {
+        expectEqual(run(source, Engine::VM), expected, "vm: " + source);
+        expectEqual(run(source, Engine::AST), expected, "ast: " + source);
+    }
+
+    std::vector<TestCase> makeTests() {
+        return {
+            {"unbound_names", [] {
+                // 只读过、没有赋值的变量读出None
+                expectOutput("print(y)\nprint(y, 1)\n", "None\nNone1\n");
+                expectOutput("print(len(str(y)))\n", "4\n");
+                // with语句结束后as变量不再存在，读出None
+                expectOutput("with open(\"tests_tmp.txt\", \"w\") as f:\n"
+                             "    f.write(\"x\")\n"
+                             "\n"
+                             "print(f)\n", "None\n");
+            }},
+            {"fstring_names", [] {
+                // f-string里未赋值的变量显示为{name}，读过一次也不算赋值
+                expectOutput("print(f\"{y}\")\n", "{y}\n");
+                expectOutput("print(y)\nprint(f\"{y}\")\n", "None\n{y}\n");
+                expectOutput("x = 3\nprint(f\"{x}+{z}\")\n", "3+{z}\n");
+                // exec()里赋值的变量在执行时才有值
+                expectOutput("exec(\"q = 5\")\nprint(f\"{q}\")\n", "5\n");
+                // with语句结束后as变量解除绑定
+                expectOutput("with open(\"tests_tmp.txt\", \"w\") as f:\n"
+                             "    f.write(\"x\")\n"
+                             "\n"
+                             "print(f\"{f}\")\n", "{f}\n");
+            }},
+            {"negative_zero", [] {
+                // 负零保留符号，和Python一样输出-0.0
+                char buffer[Utils::kMaxNumberLength];
+                expectEqual(std::string(buffer, Utils::formatNumber(-0.0, buffer)), "-0.0", "formatNumber(-0.0)");
+                expectEqual(std::string(buffer, Utils::formatNumber(0.0, buffer)), "0", "formatNumber(0.0)");
+                expectOutput("print(float(\"-0\"))\n", "-0.0\n");
+                expectOutput("print(f\"{float(\"-0\")}\")\n", "-0.0\n");
+                // int()的结果没有负零
+                expectOutput("print(int(\"-0.5\"))\n", "0\n");
+            }},
+            {"bytecode_cache", [] {
+                // 写入的缓存能读回并执行；内容损坏的缓存被拒绝
+                const std::string script = "tests_tmp.py";
+                std::ofstream(script, std::ios::binary) << "x = [1, 2]\nprint(f\"{x}{y}\", len(x) + 1)\n";
+                std::string cache = BytecodeCache::pathFor(script);
+                {
+                    Executor executor(false);
+                    CompilationUnit unit;
+                    unit.parseFile(script);
+                    auto code = executor.compile(unit);
+                    expectEqual(BytecodeCache::store(script, *code, executor.symbolTable()) ? "stored" : "failed",
+                                "stored", "store");
+                }
+                {
+                    OutputBuffer output(nullptr);
+                    std::string captured;
+                    output.redirect(&captured);
+                    Executor executor(false);
+                    executor.setOutput(&output);
+                    auto code = BytecodeCache::load(script, executor.symbolTable());
+                    expectEqual(code ? "loaded" : "rejected", "loaded", "load");
+                    if (code) executor.run(*code);
+                    output.flush();
+                    expectEqual(captured, "[1, 2]{y}3\n", "cached run");
+                }
+                {
+                    // 改动最后一个字节（变量名表里），文件头仍然有效
+                    std::fstream file(cache, std::ios::in | std::ios::out | std::ios::binary);
+                    file.seekg(-1, std::ios::end);
+                    char last = (char)file.get();
+                    file.seekp(-1, std::ios::end);
+                    file.put((char)(last ^ 1));
+                }
+                {
+                    Executor executor(false);
+                    auto code = BytecodeCache::load(script, executor.symbolTable());
+                    expectEqual(code ? "loaded" : "rejected", "rejected", "load corrupted");
+                }
+                std::error_code ec;
+                std::filesystem::remove(cache, ec);
+                std::filesystem::remove(std::filesystem::path(cache).parent_path(), ec);
+                std::filesystem::remove(script, ec);
+            }},
+            {"embed_variables", [] {
+                // set()注入、只在f-string里用到的变量显示它的值
+                CompiledScript script = EmbeddedInterpreter::compile("print(f\"x={x}\")\n");
+                EmbeddedInterpreter interpreter;
+                std::string output;
+                interpreter.setOutput(&output);
+                interpreter.run(script);
+                interpreter.set("x", Value(7.0));
+                interpreter.run(script);
+                expectEqual(output, "x={x}\nx=7\n", "set then f-string");
+
+                // 只被读过的名字和reset()之后的变量都不存在
+                interpreter.run(EmbeddedInterpreter::compile("y = x + 1\nprint(z)\n"));
+                Value value;
+                expectEqual(interpreter.get("y", value) ? "found" : "missing", "found", "get y");
+                expectEqual(value.toString(), "8", "y");
+                expectEqual(interpreter.get("z", value) ? "found" : "missing", "missing", "get never assigned");
+                interpreter.reset();
+                expectEqual(interpreter.get("y", value) ? "found" : "missing", "missing", "get after reset");
+                output.clear();
+                interpreter.run(script);
+                expectEqual(output, "x={x}\n", "f-string after reset");
+            }},
+            {"allocation_counts", [] {
+                // 字符串拼接、列表连接和f-string的分配次数不能回退；上限是当前的实测值
+                if (!Stats::enabled()) {
+                    expectEqual("disabled", "enabled", "build with -DCPPYTHON_STATS=1");
+                    return;
+                }
+                const std::string source =
+                    "greeting = \"Hello\"\n"
+                    "greeting = greeting + \", \" + \"world\"\n"
+                    "count = len(greeting)\n"
+                    "items = [1, 2, 3]\n"
+                    "items = items + [count]\n"
+                    "words = [\"a\", \"b\"] + [\"c\"]\n"
+                    "label = f\"{greeting}: {count} items={items}\"\n"
+                    "print(label)\n"
+                    "print(items[1:3], words[0] + words[2], str(count * 2))\n";
+                expectOutput(source, "Hello, world: 12 items=[1, 2, 3, 12]\n[2, 3]ac24\n");
+                expectAtMost(countDuring(source, Engine::VM, Stats::Counter::string_allocs), 12, "vm string_allocs");
+                expectAtMost(countDuring(source, Engine::VM, Stats::Counter::list_allocs), 7, "vm list_allocs");
+                expectAtMost(countDuring(source, Engine::AST, Stats::Counter::string_allocs), 10, "ast string_allocs");
+                expectAtMost(countDuring(source, Engine::AST, Stats::Counter::list_allocs), 7, "ast list_allocs");
+            }},
+            {"worker_values", [] {
+                // 取回的值是深拷贝；文件对象不能跨线程，这个任务失败而不是共享它
+                CompiledScript script = EmbeddedInterpreter::compile(
+                    "y = [x, \"a\"]\nf = open(\"tests_tmp.txt\", \"w\")\nfiles = [f]\n");
+                std::vector<WorkerPool::Job> jobs(2);
+                for (auto& job : jobs) {
+                    job.script = script;
+                    job.inputs = {{"x", Value(1.0)}};
+                }
+                jobs[0].outputs = {"y"};
+                jobs[1].outputs = {"y", "files"};
+                WorkerPool pool(2);
+                std::vector<WorkerPool::Result> results = pool.run(jobs);
+                expectEqual(results[0].ok ? "ok" : results[0].error, "ok", "plain values");
+                expectEqual(results[0].values.empty() ? "" : results[0].values[0].second.toString(), "[1, a]", "y");
+                expectEqual(results[1].ok ? "ok" : results[1].error,
+                            "Cannot pass file object 'tests_tmp.txt' to another thread", "file object");
+            }},
+            {"map_files", [] {
+                // --map：每个文件执行一次，f-string里的__file__是这个文件的路径，输出按文件顺序
+                std::ofstream("tests_tmp_map.py") << "print(f\"{__file__}: {input()}\")\n";
+                std::ofstream("tests_tmp_map_a.txt") << "alpha\n";
+                std::ofstream("tests_tmp_map_b.txt") << "beta\n";
+                std::string captured;
+                std::string* previous = OutputBuffer::standardOutput().redirect(&captured);
+                bool ok = PythonInterpreter().mapFiles("tests_tmp_map.py", "tests_tmp_map_*.txt", 2);
+                OutputBuffer::standardOutput().redirect(previous);
+                expectEqual(ok ? "ok" : "failed", "ok", "mapFiles");
+                expectEqual(captured, "tests_tmp_map_a.txt: alpha\ntests_tmp_map_b.txt: beta\n", "map output");
+                for (const char* file : {"tests_tmp_map.py", "tests_tmp_map_a.txt", "tests_tmp_map_b.txt"}) {
+                    std::remove(file);
+                }
+            }},
+            {"async_wait_any_thread", [] {
+                // 请求可以在另一个线程上等待，发出请求的线程退出以后也能取到结果
+                std::ofstream("tests_tmp.txt", std::ios::binary) << "hello";
+#ifdef _WIN32
+                int fd = _open("tests_tmp.txt", _O_RDONLY | _O_BINARY);
+#else
+                int fd = ::open("tests_tmp.txt", O_RDONLY);
+#endif
+                char first[5] = {};
+                char second[5] = {};
+                char third[5] = {};
+                long long n = -1;
+                AsyncIO::Ticket orphaned = 0;
+                AsyncIO::Ticket unsubmitted = 0;
+                std::thread([&] {
+                    AsyncIO::Ticket ticket = AsyncIO::read(fd, first, sizeof(first), 0);
+                    AsyncIO::submit();
+                    std::thread([&] { n = AsyncIO::wait(ticket); }).join();
+                    orphaned = AsyncIO::read(fd, second, sizeof(second), 0);
+                    AsyncIO::submit();
+                    // 和文件对象的预读一样只排队不提交，由等待的线程交出去
+                    unsubmitted = AsyncIO::read(fd, third, sizeof(third), 0);
+                }).join();
+                expectEqual(std::to_string(n) + std::string(first, sizeof(first)), "5hello", "wait on another thread");
+                n = AsyncIO::wait(orphaned);
+                expectEqual(std::to_string(n) + std::string(second, sizeof(second)), "5hello", "wait after the thread exited");
+                n = AsyncIO::wait(unsubmitted);
+                expectEqual(std::to_string(n) + std::string(third, sizeof(third)), "5hello", "wait for an unsubmitted request");
+                // 同一个请求不能等待两次
+                bool threw = false;
+                try {
+                    AsyncIO::wait(orphaned);
+                } catch (const std::logic_error&) {
+                    threw = true;
+                }
+                expectEqual(threw ? "threw" : "returned", "threw", "wait twice");
+#ifdef _WIN32
+                _close(fd);
+#else
+                ::close(fd);
+#endif
+            }},
+        };
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--filter NAME]" << std::endl;
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    int total = 0;
+    for (const auto& test : makeTests()) {
+        if (!filter.empty() && std::string(test.name).find(filter) == std::string::npos) {
+            continue;
+        }
+        total++;
+        int before = failures;
+        try {
+            test.body();
+        } catch (const std::exception& e) {
+            failures++;
+            std::cerr << "  exception: " << e.what() << "\n";
+        }
+        bool passed = failures == before;
+        if (!passed) failed++;
+        std::fprintf(stderr, "%-24s %s\n", test.name, passed ? "ok" : "FAILED");
+    }
+    std::remove("tests_tmp.txt");
+
+    std::fprintf(stderr, "%d/%d passed\n", total - failed, total);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,2 @@
+g++ -std=c++17 -O3 -s -pthread -DNDEBUG -DCPPYTHON_NO_MAIN -Isrc src/*.cpp bench/bench.cpp -o bench.exe
+bench.exe --output bench_output.txt
\ No newline at end of file
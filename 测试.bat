@@ -0,0 +1,4 @@
+g++ -std=c++17 -O2 -pthread -DNDEBUG -DCPPYTHON_STATS=1 -DCPPYTHON_NO_MAIN -Isrc src/*.cpp tests/tests.cpp -o tests.exe
+tests.exe
+set CPPYTHON_ASYNC_IO=threads
+tests.exe --filter async
\ No newline at end of file
@@ -1 +1 @@
-g++ -std=c++17 -O3 -s -flto -static -DNDEBUG src/*.cpp -o cppython.exe
\ No newline at end of file
+g++ -std=c++17 -O3 -s -flto -static -pthread -DNDEBUG src/*.cpp -o cppython.exe
\ No newline at end of file